@@ -0,0 +1,103 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*!
+ * A small pool of worker threads for splitting one job
+ * across several cores. The calling thread runs task 0,
+ * and each worker thread runs one of the remaining tasks.
+ * The threads are created once and reused for each job.
+ */
+class WorkerPool
+{
+public:
+    typedef std::function<void(const size_t)> Task;
+
+    WorkerPool(const size_t numThreads):
+        _done(false),
+        _generation(0),
+        _task(nullptr),
+        _numTasks(0),
+        _remaining(0)
+    {
+        for (size_t i = 0; i < numThreads; i++)
+        {
+            _threads.push_back(std::thread(&WorkerPool::workerLoop, this, i+1));
+        }
+    }
+
+    ~WorkerPool(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done = true;
+        }
+        _cond.notify_all();
+        for (auto &thread : _threads) thread.join();
+    }
+
+    //! The number of tasks that can run concurrently
+    size_t size(void) const
+    {
+        return _threads.size()+1;
+    }
+
+    /*!
+     * Run task(i) for i in [0, numTasks) and wait for all to complete.
+     * The number of tasks must not exceed the size of the pool.
+     */
+    void run(const size_t numTasks, const Task &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _task = &task;
+            _numTasks = numTasks;
+            _remaining = numTasks-1;
+            _generation++;
+        }
+        _cond.notify_all();
+
+        task(0);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        _doneCond.wait(lock, [this]{return _remaining == 0;});
+        _task = nullptr;
+    }
+
+private:
+
+    void workerLoop(const size_t index)
+    {
+        size_t generation = 0;
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _cond.wait(lock, [&]{return _done or _generation != generation;});
+            if (_done) return;
+            generation = _generation;
+            if (index >= _numTasks) continue;
+
+            const Task &task = *_task;
+            lock.unlock();
+            task(index);
+            lock.lock();
+            if (--_remaining == 0) _doneCond.notify_one();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::condition_variable _doneCond;
+    bool _done;
+    size_t _generation;
+    const Task *_task;
+    size_t _numTasks;
+    size_t _remaining;
+    std::vector<std::thread> _threads;
+};
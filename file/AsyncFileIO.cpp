@@ -0,0 +1,338 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "AsyncFileIO.hpp"
+#include <Pothos/Framework.hpp>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib> //free
+#include <algorithm> //min/max
+#include <vector>
+#include <Poco/Logger.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#endif //_MSC_VER
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+
+static int sys_io_uring_setup(const unsigned entries, io_uring_params *params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int sys_io_uring_enter(const int fd, const unsigned toSubmit, const unsigned minComplete, const unsigned flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int sys_io_uring_register(const int fd, const unsigned opcode, void *arg, const unsigned nrArgs)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs));
+}
+
+/*!
+ * Kernels before 5.6 accept the ring but fail every read and write,
+ * and those kernels do not support the probe either.
+ */
+static bool supportsReadWrite(const int fd)
+{
+    const unsigned numOps = 256;
+    std::vector<io_uring_probe_op> mem(numOps + (sizeof(io_uring_probe) + sizeof(io_uring_probe_op) - 1)/sizeof(io_uring_probe_op));
+    auto probe = reinterpret_cast<io_uring_probe *>(mem.data());
+    if (sys_io_uring_register(fd, IORING_REGISTER_PROBE, probe, numOps) < 0) return false;
+    for (const int op : {IORING_OP_READ, IORING_OP_WRITE})
+    {
+        if (op > probe->last_op or (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) return false;
+    }
+    return true;
+}
+
+static const int OP_READ = IORING_OP_READ;
+static const int OP_WRITE = IORING_OP_WRITE;
+#else
+static const int OP_READ = 0;
+static const int OP_WRITE = 1;
+#endif //HAVE_IO_URING
+
+#define ringPtr(base, offset) reinterpret_cast<unsigned *>(static_cast<char *>(base) + (offset))
+
+AsyncFileIO::AsyncFileIO(const unsigned queueDepth):
+    _ringFd(-1),
+    _queueDepth(queueDepth),
+    _outstanding(0),
+    _toSubmit(0),
+    _sqRing(nullptr),
+    _sqRingSize(0),
+    _cqRing(nullptr),
+    _cqRingSize(0),
+    _sqes(nullptr),
+    _sqesSize(0),
+    _sqTail(nullptr),
+    _sqMask(nullptr),
+    _sqArray(nullptr),
+    _cqHead(nullptr),
+    _cqTail(nullptr),
+    _cqMask(nullptr),
+    _cqes(nullptr)
+{
+    if (queueDepth == 0) throw Pothos::InvalidArgumentException("AsyncFileIO()", "queue depth cannot be zero");
+
+    #ifdef HAVE_IO_URING
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int fd = sys_io_uring_setup(queueDepth, &params);
+    if (fd < 0) return; //not supported by this kernel, use the synchronous fallback
+    if (not supportsReadWrite(fd))
+    {
+        close(fd);
+        return;
+    }
+
+    _sqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    _cqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap) _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+    _sqesSize = params.sq_entries*sizeof(io_uring_sqe);
+
+    _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    _cqRing = singleMap? _sqRing : mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    _sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (_sqRing == MAP_FAILED or _cqRing == MAP_FAILED or _sqes == MAP_FAILED)
+    {
+        if (_sqes != MAP_FAILED) munmap(_sqes, _sqesSize);
+        if (_cqRing != MAP_FAILED and not singleMap) munmap(_cqRing, _cqRingSize);
+        if (_sqRing != MAP_FAILED) munmap(_sqRing, _sqRingSize);
+        close(fd);
+        return;
+    }
+
+    _sqTail = ringPtr(_sqRing, params.sq_off.tail);
+    _sqMask = ringPtr(_sqRing, params.sq_off.ring_mask);
+    _sqArray = ringPtr(_sqRing, params.sq_off.array);
+    _cqHead = ringPtr(_cqRing, params.cq_off.head);
+    _cqTail = ringPtr(_cqRing, params.cq_off.tail);
+    _cqMask = ringPtr(_cqRing, params.cq_off.ring_mask);
+    _cqes = static_cast<char *>(_cqRing) + params.cq_off.cqes;
+    _queueDepth = std::min(queueDepth, params.sq_entries);
+    _ringFd = fd;
+    #endif //HAVE_IO_URING
+}
+
+AsyncFileIO::~AsyncFileIO(void)
+{
+    this->drain();
+
+    #ifdef HAVE_IO_URING
+    if (_ringFd < 0) return;
+    munmap(_sqes, _sqesSize);
+    if (_cqRing != _sqRing) munmap(_cqRing, _cqRingSize);
+    munmap(_sqRing, _sqRingSize);
+    close(_ringFd);
+    #endif //HAVE_IO_URING
+}
+
+const size_t AsyncFileIO::ALIGNMENT;
+
+std::shared_ptr<void> AsyncFileIO::allocate(const size_t size)
+{
+    void *mem = nullptr;
+    #ifdef _MSC_VER
+    mem = _aligned_malloc(size, ALIGNMENT);
+    std::shared_ptr<void> container(mem, _aligned_free);
+    #else
+    if (posix_memalign(&mem, ALIGNMENT, size) != 0) mem = nullptr;
+    std::shared_ptr<void> container(mem, std::free);
+    #endif //_MSC_VER
+    if (mem == nullptr) throw Pothos::OutOfMemoryException("AsyncFileIO::allocate()", "aligned allocation failed");
+    return container;
+}
+
+void AsyncFileIO::read(const int fd, void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag)
+{
+    this->queue(OP_READ, fd, buff, len, offset, tag);
+}
+
+void AsyncFileIO::write(const int fd, const void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag)
+{
+    this->queue(OP_WRITE, fd, buff, len, offset, tag);
+}
+
+void AsyncFileIO::queue(const int opcode, const int fd, const void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag)
+{
+    if (_outstanding >= _queueDepth) throw Pothos::RangeException("AsyncFileIO::queue()", "queue is full");
+    _outstanding++;
+
+    #ifdef HAVE_IO_URING
+    if (_ringFd >= 0)
+    {
+        //the submission ring has room because requests are limited to the queue depth
+        const unsigned tail = *_sqTail;
+        const unsigned index = tail & *_sqMask;
+        auto sqe = static_cast<io_uring_sqe *>(_sqes) + index;
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = uint8_t(opcode);
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<unsigned long long>(buff);
+        sqe->len = unsigned(len);
+        sqe->off = offset;
+        sqe->user_data = tag;
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail+1, __ATOMIC_RELEASE);
+        _toSubmit++;
+        return;
+    }
+    #endif //HAVE_IO_URING
+
+    //synchronous fallback: perform the request now
+    long result = -1;
+    if (lseek(fd, off_t(offset), SEEK_SET) >= 0)
+    {
+        if (opcode == OP_READ) result = long(::read(fd, const_cast<void *>(buff), len));
+        else result = long(::write(fd, buff, len));
+    }
+    if (result < 0) result = -errno;
+    _completed.push_back(std::make_pair(tag, result));
+}
+
+void AsyncFileIO::submit(void)
+{
+    #ifdef HAVE_IO_URING
+    while (_toSubmit != 0)
+    {
+        const int r = sys_io_uring_enter(_ringFd, _toSubmit, 0, 0);
+        if (r < 0 and errno == EINTR) continue;
+        if (r < 0) throw Pothos::IOException("AsyncFileIO::submit()", std::strerror(errno));
+        _toSubmit -= unsigned(r);
+    }
+    #endif //HAVE_IO_URING
+}
+
+bool AsyncFileIO::complete(unsigned long long &tag, long &result, const bool wait)
+{
+    #ifdef HAVE_IO_URING
+    if (_ringFd >= 0)
+    {
+        this->submit();
+        while (true)
+        {
+            const unsigned head = *_cqHead;
+            if (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+            {
+                const auto cqe = static_cast<const io_uring_cqe *>(_cqes) + (head & *_cqMask);
+                tag = cqe->user_data;
+                result = cqe->res;
+                __atomic_store_n(_cqHead, head+1, __ATOMIC_RELEASE);
+                _outstanding--;
+                return true;
+            }
+            if (not wait or _outstanding == 0) return false;
+            const int r = sys_io_uring_enter(_ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+            if (r < 0 and errno != EINTR) throw Pothos::IOException("AsyncFileIO::complete()", std::strerror(errno));
+        }
+    }
+    #endif //HAVE_IO_URING
+
+    (void)wait; //fallback requests complete when queued
+    if (_completed.empty()) return false;
+    tag = _completed.front().first;
+    result = _completed.front().second;
+    _completed.pop_front();
+    _outstanding--;
+    return true;
+}
+
+void AsyncFileIO::drain(void)
+{
+    unsigned long long tag = 0;
+    long result = 0;
+    while (_outstanding != 0 and this->complete(tag, result, true));
+}
+
+/***********************************************************************
+ * Write-behind queue of aligned blocks
+ **********************************************************************/
+AsyncFileWriter::AsyncFileWriter(const size_t queueDepth, const size_t blockSize):
+    _aio(unsigned(queueDepth)),
+    _blockSize(((blockSize + AsyncFileIO::ALIGNMENT - 1)/AsyncFileIO::ALIGNMENT)*AsyncFileIO::ALIGNMENT),
+    _slots(queueDepth+1),
+    _fillSlot(0),
+    _fillBytes(0)
+{
+    if (blockSize == 0) throw Pothos::InvalidArgumentException("AsyncFileWriter()", "block size cannot be zero");
+    for (auto &slot : _slots) slot.mem = AsyncFileIO::allocate(_blockSize);
+}
+
+AsyncFileWriter::~AsyncFileWriter(void)
+{
+    _aio.drain();
+}
+
+size_t AsyncFileWriter::fill(const void *buff, const size_t len)
+{
+    const size_t n = std::min(len, _blockSize - _fillBytes);
+    std::memcpy(static_cast<char *>(_slots[_fillSlot].mem.get()) + _fillBytes, buff, n);
+    _fillBytes += n;
+    return n;
+}
+
+size_t AsyncFileWriter::write(const int fd, const unsigned long long offset)
+{
+    //direct writes must cover whole pages, the padding is truncated by the caller
+    const size_t unit = AsyncFileIO::ALIGNMENT;
+    const size_t length = ((_fillBytes + unit - 1)/unit)*unit;
+    auto &slot = _slots[_fillSlot];
+    std::memset(static_cast<char *>(slot.mem.get()) + _fillBytes, 0, length - _fillBytes);
+    slot.busy = true;
+    slot.length = length;
+    slot.fd = fd;
+    _aio.write(fd, slot.mem.get(), length, offset, _fillSlot);
+    _aio.submit();
+    _fillBytes = 0;
+
+    //backpressure: wait for a write to complete only when the queue is full
+    while (_aio.outstanding() >= _slots.size()-1) this->reap(true);
+    for (size_t i = 0; i < _slots.size(); i++)
+    {
+        if (_slots[i].busy) continue;
+        _fillSlot = i;
+        break;
+    }
+    return length;
+}
+
+void AsyncFileWriter::reap(bool wait)
+{
+    unsigned long long tag = 0;
+    long result = 0;
+    while (_aio.complete(tag, result, wait))
+    {
+        auto &slot = _slots[size_t(tag)];
+        slot.busy = false;
+        wait = false;
+        if (result == long(slot.length)) continue;
+        if (result >= 0) errno = EIO; //short write
+        else errno = int(-result);
+        poco_error_f3(Poco::Logger::get("AsyncFileWriter"), "write() returned %d -- %s(%d)", int(result), std::string(std::strerror(errno)), errno);
+    }
+}
+
+void AsyncFileWriter::flush(void)
+{
+    while (_aio.outstanding() != 0) this->reap(true);
+}
+
+bool AsyncFileWriter::inFlight(const int fd) const
+{
+    for (const auto &slot : _slots)
+    {
+        if (slot.busy and slot.fd == fd) return true;
+    }
+    return false;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/*!
+ * Queue of asynchronous file reads and writes.
+ *
+ * On Linux, requests are submitted through io_uring with raw system calls,
+ * so that many large transfers can be in flight at once.
+ * When io_uring or its read and write requests are not available
+ * at compile time or at runtime,
+ * each request is performed synchronously when it is queued,
+ * and its completion is reported in the same way.
+ *
+ * Buffers must remain valid until the request completes.
+ * For files opened with O_DIRECT, the buffers, lengths, and offsets
+ * must be aligned to the logical block size of the device.
+ */
+class AsyncFileIO
+{
+public:
+    //! Create a queue for up to queueDepth requests in flight
+    AsyncFileIO(const unsigned queueDepth);
+
+    //! Waits for requests in flight before releasing the ring
+    ~AsyncFileIO(void);
+
+    //! Alignment of O_DIRECT buffers, lengths, and offsets
+    static const size_t ALIGNMENT = 4096;
+
+    //! Allocate a buffer aligned for O_DIRECT, throws on failure
+    static std::shared_ptr<void> allocate(const size_t size);
+
+    //! True when requests are performed asynchronously with io_uring
+    bool isAsync(void) const
+    {
+        return _ringFd >= 0;
+    }
+
+    //! The number of requests that have not been completed
+    size_t outstanding(void) const
+    {
+        return _outstanding;
+    }
+
+    //! Queue a read of len bytes at the offset, the tag identifies the completion
+    void read(const int fd, void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag);
+
+    //! Queue a write of len bytes at the offset, the tag identifies the completion
+    void write(const int fd, const void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag);
+
+    //! Submit the queued requests to the kernel
+    void submit(void);
+
+    /*!
+     * Get the next completion in any order.
+     * The result is the number of bytes transferred or a negative errno.
+     * Return false when no completion is available,
+     * or wait for one when wait is true and requests are outstanding.
+     */
+    bool complete(unsigned long long &tag, long &result, const bool wait);
+
+    //! Wait for all outstanding requests to complete, discarding the results
+    void drain(void);
+
+private:
+    void queue(const int opcode, const int fd, const void *buff, const size_t len, const unsigned long long offset, const unsigned long long tag);
+
+    int _ringFd;
+    unsigned _queueDepth;
+    size_t _outstanding;
+    unsigned _toSubmit;
+
+    //io_uring mappings
+    void *_sqRing;
+    size_t _sqRingSize;
+    void *_cqRing;
+    size_t _cqRingSize;
+    void *_sqes;
+    size_t _sqesSize;
+    unsigned *_sqTail;
+    unsigned *_sqMask;
+    unsigned *_sqArray;
+    unsigned *_cqHead;
+    unsigned *_cqTail;
+    unsigned *_cqMask;
+    void *_cqes;
+
+    //completions of the synchronous fallback
+    std::deque<std::pair<unsigned long long, long>> _completed;
+};
+
+/*!
+ * Write-behind queue of aligned blocks for the file sinks.
+ *
+ * One block is filled while the others are written in the background,
+ * and submitting a block waits for a write to complete
+ * only when all of the blocks are in flight.
+ * Failed and short writes are logged when they are collected.
+ */
+class AsyncFileWriter
+{
+public:
+    //! Create queueDepth+1 blocks, the block size is rounded up to the alignment
+    AsyncFileWriter(const size_t queueDepth, const size_t blockSize);
+
+    //! Waits for writes in flight before releasing the blocks
+    ~AsyncFileWriter(void);
+
+    //! True when writes are performed asynchronously with io_uring
+    bool isAsync(void) const
+    {
+        return _aio.isAsync();
+    }
+
+    //! The size of each block in bytes
+    size_t blockSize(void) const
+    {
+        return _blockSize;
+    }
+
+    //! The number of bytes in the block being filled
+    size_t fillBytes(void) const
+    {
+        return _fillBytes;
+    }
+
+    //! Copy as much as fits into the block being filled, return the number of bytes copied
+    size_t fill(const void *buff, const size_t len);
+
+    //! True when the block being filled has no space left
+    bool full(void) const
+    {
+        return _fillBytes == _blockSize;
+    }
+
+    /*!
+     * Write the block being filled to the file at the offset,
+     * and find a free block to fill next.
+     * A partial block is padded with zeros to whole pages for direct I/O.
+     * Return the number of bytes written, including the padding.
+     */
+    size_t write(const int fd, const unsigned long long offset);
+
+    //! Collect completed writes, wait for at least one when requested
+    void reap(bool wait);
+
+    //! Wait for all writes in flight, the partial block is not written
+    void flush(void);
+
+    //! True when a write to the file has not completed
+    bool inFlight(const int fd) const;
+
+private:
+    struct WriteSlot
+    {
+        WriteSlot(void): busy(false), length(0), fd(-1){}
+        std::shared_ptr<void> mem;
+        bool busy;
+        size_t length;
+        int fd;
+    };
+
+    AsyncFileIO _aio;
+    size_t _blockSize;
+    std::vector<WriteSlot> _slots;
+    size_t _fillSlot;
+    size_t _fillBytes;
+};
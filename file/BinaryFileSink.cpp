@@ -1,6 +1,8 @@
 // Copyright (c) 2014-2017 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "AsyncFileIO.hpp"
+#include "FileMetadata.hpp"
 #include <Pothos/Framework.hpp>
 
 #include <fcntl.h>
@@ -8,11 +10,18 @@
 #include <sys/stat.h>
 #ifdef _MSC_VER
 #include <io.h>
+#define ftruncate _chsize_s
 #else
 #include <unistd.h>
 #endif //_MSC_VER
 #include <stdio.h>
 #include <cerrno>
+#include <cstring>
+#include <algorithm> //min
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <future>
 
 #ifndef O_BINARY
 #define O_BINARY 0
@@ -32,6 +41,17 @@
  *
  * Read streaming data from port 0 and write the contents to a file.
  *
+ * <h2>Metadata</h2>
+ *
+ * When metadata is enabled, the labels and messages of the input port
+ * are recorded to a sidecar file (the file path with a ".meta" suffix).
+ * Labels are recorded with the absolute element index in the data file,
+ * and messages, including packets, are recorded with the number of elements before them.
+ * The data type of the input buffers is also recorded.
+ * The binary file source restores the labels and messages when its metadata option is enabled.
+ * With rolling segments, a single sidecar covers all of the segments.
+ * Messages are always consumed, and discarded when metadata is disabled.
+ *
  * |category /Sinks
  * |category /File IO
  * |keywords sink binary file
@@ -45,9 +65,70 @@
  * |option [Disabled] false
  * |default true
  *
+ * |param queueDepth[Queue Depth] The number of writes to keep in flight.
+ * When non-zero, input is gathered into large blocks which are written behind
+ * with asynchronous I/O (io_uring on Linux), so that the work thread
+ * does not wait on the storage device unless all of the writes are in flight.
+ * When zero, the input buffer is written synchronously.
+ * |default 0
+ * |preview valid
+ *
+ * |param blockSize[Block Size] The size of each asynchronous write in bytes.
+ * The size is rounded up to a multiple of the page size.
+ * |default 1048576
+ * |units bytes
+ * |preview valid
+ *
+ * |param directIO[Direct I/O] Bypass the page cache for asynchronous writes.
+ * The file is opened with O_DIRECT when supported by the platform and filesystem,
+ * otherwise the file is written through the page cache.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param preallocate[Pre-allocate] Reserve storage for each file when it is opened.
+ * Reserving the storage up front keeps the file contiguous on disk
+ * and avoids filesystem metadata updates as the file grows.
+ * Unused storage is released when the file is closed.
+ * Pre-allocation is only supported on Linux, and it is ignored elsewhere.
+ * |default 0
+ * |units bytes
+ * |preview valid
+ *
+ * |param segmentSize[Segment Size] Roll over to a new file after this many bytes.
+ * When rolling is enabled, the recording is split into numbered segment files,
+ * and a number is inserted before the extension of the file path:
+ * for example, "capture.dat" is recorded as "capture_0000.dat", "capture_0001.dat", and so on.
+ * With asynchronous writes, segments are rounded up to a whole number of blocks.
+ * Zero disables rolling by size.
+ * |default 0
+ * |units bytes
+ * |preview valid
+ *
+ * |param segmentTime[Segment Time] Roll over to a new file after this many seconds.
+ * The rollover happens at the next input buffer, or at the next block with asynchronous writes.
+ * Zero disables rolling by time.
+ * |default 0.0
+ * |units seconds
+ * |preview valid
+ *
+ * |param metadata[Metadata] Record labels and messages to a sidecar file.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
  * |factory /blocks/binary_file_sink()
  * |setter setFilePath(path)
  * |setter setEnabled(enabled)
+ * |setter setQueueDepth(queueDepth)
+ * |setter setBlockSize(blockSize)
+ * |setter setDirectIO(directIO)
+ * |setter setPreallocate(preallocate)
+ * |setter setSegmentSize(segmentSize)
+ * |setter setSegmentTime(segmentTime)
+ * |setter setMetadata(metadata)
  **********************************************************************/
 class BinaryFileSink : public Pothos::Block
 {
@@ -59,11 +140,30 @@ public:
 
     BinaryFileSink(void):
         _fd(-1),
-        _enabled(true)
+        _enabled(true),
+        _queueDepth(0),
+        _blockSize(1024*1024),
+        _directIO(false),
+        _fileOffset(0),
+        _preallocate(0),
+        _segmentSize(0),
+        _segmentTime(0.0),
+        _segmentIndex(0),
+        _metadata(false),
+        _totalBytes(0)
     {
         this->setupInput(0);
         this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setFilePath));
         this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setEnabled));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setQueueDepth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setBlockSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setDirectIO));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setPreallocate));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setSegmentSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setSegmentTime));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, getSegmentIndex));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSink, setMetadata));
+        this->registerProbe("getSegmentIndex", "probeSegmentIndex", "segmentIndexTriggered");
     }
 
     void setFilePath(const std::string &path)
@@ -82,32 +182,126 @@ public:
         _enabled = enabled;
     }
 
+    void setQueueDepth(const size_t queueDepth)
+    {
+        _queueDepth = queueDepth;
+    }
+
+    void setBlockSize(const size_t blockSize)
+    {
+        if (blockSize == 0) throw Pothos::InvalidArgumentException("BinaryFileSink::setBlockSize()", "block size cannot be zero");
+        _blockSize = blockSize;
+    }
+
+    void setDirectIO(const bool directIO)
+    {
+        _directIO = directIO;
+    }
+
+    void setPreallocate(const unsigned long long preallocate)
+    {
+        _preallocate = preallocate;
+    }
+
+    void setSegmentSize(const unsigned long long segmentSize)
+    {
+        _segmentSize = segmentSize;
+    }
+
+    void setSegmentTime(const double segmentTime)
+    {
+        if (segmentTime < 0.0) throw Pothos::InvalidArgumentException("BinaryFileSink::setSegmentTime()", "segment time cannot be negative");
+        _segmentTime = segmentTime;
+    }
+
+    void setMetadata(const bool metadata)
+    {
+        _metadata = metadata;
+    }
+
+    size_t getSegmentIndex(void) const
+    {
+        return _segmentIndex;
+    }
+
     void activate(void)
     {
         if (_path.empty()) throw Pothos::FileException("BinaryFileSink", "empty file path");
-        _fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, MY_S_IREADWRITE);
-        if (_fd < 0)
-        {
-            poco_error_f4(Poco::Logger::get("BinaryFileSink"), "open(%s) returned %d -- %s(%d)", _path, _fd, std::string(strerror(errno)), errno);
-        }
+        _segmentIndex = 0;
+        _fileOffset = 0;
+        _fd = this->openFile(this->segmentPath(_segmentIndex));
+        _segmentStart = std::chrono::steady_clock::now();
+        if (this->rolling()) this->prepareNextSegment();
+
+        _totalBytes = 0;
+        _dtype = Pothos::DType();
+        if (_metadata) _metaWriter.reset(new FileMetadataWriter(fileMetadataPath(_path)));
+
+        //one block is filled while the others are in flight
+        if (_queueDepth != 0 and _fd >= 0) _writer.reset(new AsyncFileWriter(_queueDepth, _blockSize));
     }
 
     void deactivate(void)
     {
-        close(_fd);
+        //the padding of the final block and unused pre-allocation are truncated
+        bool truncate = _preallocate != 0;
+        if (_writer)
+        {
+            const auto fileSize = _fileOffset + _writer->fillBytes();
+            this->flush();
+            truncate = truncate or _fileOffset != fileSize;
+            _fileOffset = fileSize;
+        }
+        _writer.reset();
+        this->closeFile(_fd, _fileOffset, truncate);
         _fd = -1;
+
+        try
+        {
+            if (_metaWriter) _metaWriter->flush();
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            poco_error(Poco::Logger::get("BinaryFileSink"), ex.displayText());
+        }
+        _metaWriter.reset();
+
+        //the next segment was opened ahead of time but never written
+        if (_nextFd.valid())
+        {
+            const int fd = _nextFd.get();
+            if (fd >= 0) close(fd);
+            unlink(_nextPath.c_str());
+        }
     }
 
     void work(void)
     {
         auto in0 = this->input(0);
+
+        //messages are recorded at the current stream position
+        while (in0->hasMessage())
+        {
+            const auto msg = in0->popMessage();
+            if (_enabled and _metaWriter) _metaWriter->write(FileMetadataRecord::MESSAGE, _totalBytes/this->elemSize(), msg);
+        }
+
         if (in0->elements() == 0) return;
         if (!_enabled) in0->consume(in0->elements());
+        else if (_writer) this->workAsync();
         else
         {
+            if (this->segmentDue()) this->nextSegment();
+            size_t length = in0->elements();
+            if (_segmentSize != 0) length = size_t(std::min<unsigned long long>(length, _segmentSize - _fileOffset));
             const void *ptr = in0->buffer();
-            auto r = write(_fd, ptr, in0->elements());
-            if (r >= 0) in0->consume(size_t(r));
+            auto r = write(_fd, ptr, length);
+            if (r >= 0)
+            {
+                this->recordLabels(size_t(r));
+                in0->consume(size_t(r));
+                _fileOffset += size_t(r);
+            }
             else
             {
                 poco_error_f3(Poco::Logger::get("BinaryFileSink"), "write() returned %d -- %s(%d)", int(r), std::string(strerror(errno)), errno);
@@ -116,9 +310,194 @@ public:
     }
 
 private:
+
+    /*!
+     * Copy the input into the block being filled,
+     * and write each full block behind the stream.
+     * The input is always consumed entirely.
+     */
+    void workAsync(void)
+    {
+        auto in0 = this->input(0);
+        const char *ptr = in0->buffer();
+        const size_t length = in0->elements();
+        size_t offset = 0;
+        while (offset < length)
+        {
+            offset += _writer->fill(ptr + offset, length - offset);
+            if (not _writer->full()) continue;
+            _fileOffset += _writer->write(_fd, _fileOffset);
+            if (this->segmentDue()) this->nextSegment();
+        }
+        this->recordLabels(length);
+        in0->consume(length);
+
+        //release the completed writes without waiting
+        this->reap(false);
+    }
+
+    //collect completed writes, and close the segments they were written to
+    void reap(const bool wait)
+    {
+        _writer->reap(wait);
+        this->closeRetired();
+    }
+
+    //write the partial block and wait for all writes to complete
+    void flush(void)
+    {
+        if (_writer->fillBytes() != 0) _fileOffset += _writer->write(_fd, _fileOffset);
+        _writer->flush();
+        this->closeRetired();
+    }
+
+    size_t elemSize(void) const
+    {
+        return std::max<size_t>(1, _dtype.size());
+    }
+
+    //record the labels of the bytes about to be consumed with absolute element indexes
+    void recordLabels(const size_t bytes)
+    {
+        auto in0 = this->input(0);
+        if (_metaWriter)
+        {
+            const auto &dtype = in0->buffer().dtype;
+            if (dtype != _dtype)
+            {
+                _dtype = dtype;
+                _metaWriter->write(FileMetadataRecord::DTYPE, _totalBytes/this->elemSize(), Pothos::Object(_dtype));
+            }
+            for (const auto &label : in0->labels())
+            {
+                if (label.index >= bytes) continue;
+                Pothos::Label absLabel(label);
+                absLabel.index = (_totalBytes + label.index)/this->elemSize();
+                absLabel.width = std::max<size_t>(1, label.width/this->elemSize());
+                _metaWriter->write(FileMetadataRecord::LABEL, absLabel.index, Pothos::Object(absLabel));
+            }
+        }
+        _totalBytes += bytes;
+    }
+
+    //open a file for writing and reserve its storage
+    int openFile(const std::string &path) const
+    {
+        int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+        #ifdef O_DIRECT
+        if (_queueDepth != 0 and _directIO) flags |= O_DIRECT;
+        #endif //O_DIRECT
+        int fd = open(path.c_str(), flags, MY_S_IREADWRITE);
+        #ifdef O_DIRECT
+        if (fd < 0 and errno == EINVAL and (flags & O_DIRECT) != 0)
+        {
+            poco_warning_f1(Poco::Logger::get("BinaryFileSink"), "O_DIRECT not supported for %s, using the page cache", path);
+            fd = open(path.c_str(), flags & ~O_DIRECT, MY_S_IREADWRITE);
+        }
+        #endif //O_DIRECT
+        if (fd < 0)
+        {
+            poco_error_f4(Poco::Logger::get("BinaryFileSink"), "open(%s) returned %d -- %s(%d)", path, fd, std::string(strerror(errno)), errno);
+            return fd;
+        }
+
+        //reserve the storage without changing the file size
+        #ifdef FALLOC_FL_KEEP_SIZE
+        if (_preallocate != 0 and fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, off_t(_preallocate)) != 0)
+        {
+            poco_warning_f3(Poco::Logger::get("BinaryFileSink"), "fallocate(%s) failed -- %s(%d)", path, std::string(strerror(errno)), errno);
+        }
+        #endif //FALLOC_FL_KEEP_SIZE
+        return fd;
+    }
+
+    //truncate to the recorded size and close the file
+    void closeFile(const int fd, const unsigned long long size, const bool truncate)
+    {
+        if (fd < 0) return;
+        if (truncate and ftruncate(fd, off_t(size)) != 0)
+        {
+            poco_error_f3(Poco::Logger::get("BinaryFileSink"), "ftruncate() returned %d -- %s(%d)", -1, std::string(strerror(errno)), errno);
+        }
+        close(fd);
+    }
+
+    bool rolling(void) const
+    {
+        return _segmentSize != 0 or _segmentTime > 0.0;
+    }
+
+    bool segmentDue(void) const
+    {
+        if (_segmentSize != 0 and _fileOffset >= _segmentSize) return true;
+        if (_segmentTime <= 0.0) return false;
+        const std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - _segmentStart);
+        return elapsed.count() >= _segmentTime;
+    }
+
+    //segment files are numbered when rolling is enabled
+    std::string segmentPath(const size_t index) const
+    {
+        if (not this->rolling()) return _path;
+        return numberedFilePath(_path, index);
+    }
+
+    //open and pre-allocate the next segment in the background
+    void prepareNextSegment(void)
+    {
+        _nextPath = this->segmentPath(_segmentIndex+1);
+        _nextFd = std::async(std::launch::async, &BinaryFileSink::openFile, this, _nextPath);
+    }
+
+    //switch to the segment that was prepared ahead of time
+    void nextSegment(void)
+    {
+        //rolling was enabled after the sink was activated
+        if (not _nextFd.valid()) this->prepareNextSegment();
+        const int nextFd = _nextFd.get();
+        if (_writer) _retired.push_back(std::make_pair(_fd, _fileOffset));
+        else this->closeFile(_fd, _fileOffset, _preallocate != 0);
+        _fd = nextFd;
+        _fileOffset = 0;
+        _segmentIndex++;
+        _segmentStart = std::chrono::steady_clock::now();
+        this->prepareNextSegment();
+    }
+
+    //close previous segments once their writes have completed
+    void closeRetired(void)
+    {
+        for (auto it = _retired.begin(); it != _retired.end();)
+        {
+            if (_writer->inFlight(it->first)) ++it;
+            else
+            {
+                this->closeFile(it->first, it->second, _preallocate != 0);
+                it = _retired.erase(it);
+            }
+        }
+    }
+
     int _fd;
     std::string _path;
     bool _enabled;
+    size_t _queueDepth;
+    size_t _blockSize;
+    bool _directIO;
+    std::unique_ptr<AsyncFileWriter> _writer;
+    unsigned long long _fileOffset;
+    unsigned long long _preallocate;
+    unsigned long long _segmentSize;
+    double _segmentTime;
+    size_t _segmentIndex;
+    std::chrono::steady_clock::time_point _segmentStart;
+    std::future<int> _nextFd;
+    std::string _nextPath;
+    std::vector<std::pair<int, unsigned long long>> _retired;
+    bool _metadata;
+    std::unique_ptr<FileMetadataWriter> _metaWriter;
+    unsigned long long _totalBytes;
+    Pothos::DType _dtype;
 };
 
 static Pothos::BlockRegistry registerBinaryFileSink(
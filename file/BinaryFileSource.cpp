@@ -1,6 +1,8 @@
 // Copyright (c) 2014-2016 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "AsyncFileIO.hpp"
+#include "FileMetadata.hpp"
 #include <Pothos/Framework.hpp>
 
 #include <fcntl.h>
@@ -10,9 +12,18 @@
 #include <io.h>
 #else
 #include <unistd.h>
+#include <sys/mman.h>
 #endif //_MSC_VER
 #include <stdio.h>
 #include <cerrno>
+#include <cstring>
+#include <algorithm> //min
+#include <memory>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <limits>
 
 #ifndef O_BINARY
 #define O_BINARY 0
@@ -25,6 +36,21 @@
  *
  * Read data from a file and write it to an output stream on port 0.
  *
+ * <h2>Seeking and pacing</h2>
+ *
+ * Playback begins at the start offset and stops after the length,
+ * both in elements, or at the end of the file when the length is zero.
+ * The seek(index) call moves playback to an element index in the file,
+ * and the seekTime(seconds) call moves playback to a time in the recording
+ * according to the sample rate. The getPosition() call and probe
+ * report the index of the next element in the file.
+ *
+ * When pacing is enabled, elements are released at the sample rate.
+ * Each element has an absolute deadline from the start of playback,
+ * so the rate does not drift over time, and the block only waits
+ * when the next element is not due yet.
+ * An "rxRate" label with the sample rate is posted when playback begins.
+ *
  * |category /Sources
  * |category /File IO
  * |keywords source binary file
@@ -39,8 +65,82 @@
  * |widget FileEntry(mode=open)
  *
  * |param rewind[Auto Rewind] Enable automatic file rewind.
- * When rewind is enabled, the binary file source will stream from the beginning
- * of the file after the end of file is reached.
+ * When rewind is enabled, the binary file source will stream from the start offset
+ * after the end of file or the end of the length is reached.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param memoryMap[Memory Map] Read the file through a memory mapping.
+ * When enabled, a window of the file is mapped into memory for each output buffer,
+ * and the mapping is posted downstream without copying the file contents.
+ * The kernel is advised to read ahead of the window for sequential access.
+ * The mapping is private, so downstream blocks never modify the file.
+ * Memory mapping is not supported on Windows.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param windowSize[Window Size] The size of each mapped window in bytes.
+ * Only used when memory mapping is enabled.
+ * Large windows reduce the number of mapping calls,
+ * and small windows reduce the memory held by downstream blocks.
+ * |default 16777216
+ * |units bytes
+ * |preview valid
+ *
+ * |param queueDepth[Queue Depth] The number of reads to keep in flight.
+ * When non-zero, the file is read in large blocks with asynchronous I/O
+ * (io_uring on Linux), and each block is posted downstream without a copy.
+ * Several reads are kept in flight so that the storage device is never idle.
+ * When zero, the file is read synchronously into the output buffer.
+ * Memory mapping takes precedence over asynchronous reads.
+ * |default 0
+ * |preview valid
+ *
+ * |param blockSize[Block Size] The size of each asynchronous read in bytes.
+ * The size is rounded up to a multiple of both the page size and the element size.
+ * |default 1048576
+ * |units bytes
+ * |preview valid
+ *
+ * |param directIO[Direct I/O] Bypass the page cache for asynchronous reads.
+ * The file is opened with O_DIRECT when supported by the platform and filesystem,
+ * otherwise the file is read through the page cache.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param metadata[Metadata] Restore the labels and messages of the recording.
+ * When enabled, the labels and messages recorded by the binary file sink
+ * are read from the metadata sidecar (the file path with a ".meta" suffix),
+ * and they are posted at their original positions in the stream.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param startOffset[Start Offset] The index of the first element to play back.
+ * |default 0
+ * |units elements
+ * |preview valid
+ *
+ * |param length[Length] The number of elements to play back.
+ * Zero plays back to the end of the file.
+ * |default 0
+ * |units elements
+ * |preview valid
+ *
+ * |param sampleRate[Sample Rate] The sample rate of the recording.
+ * Used for pacing and for seeking by time.
+ * |default 1e6
+ * |units samples/sec
+ * |preview valid
+ *
+ * |param pacing[Pacing] Release elements at the sample rate.
  * |default false
  * |option [Disabled] false
  * |option [Enabled] true
@@ -49,6 +149,16 @@
  * |factory /blocks/binary_file_source(dtype)
  * |setter setFilePath(path)
  * |setter setAutoRewind(rewind)
+ * |setter setMemoryMap(memoryMap)
+ * |setter setWindowSize(windowSize)
+ * |setter setQueueDepth(queueDepth)
+ * |setter setBlockSize(blockSize)
+ * |setter setDirectIO(directIO)
+ * |setter setMetadata(metadata)
+ * |setter setStartOffset(startOffset)
+ * |setter setLength(length)
+ * |setter setSampleRate(sampleRate)
+ * |setter setPacing(pacing)
  **********************************************************************/
 class BinaryFileSource : public Pothos::Block
 {
@@ -60,11 +170,51 @@ public:
 
     BinaryFileSource(const Pothos::DType &dtype):
         _fd(-1),
-        _rewind(false)
+        _rewind(false),
+        _memoryMap(false),
+        _windowSize(16*1024*1024),
+        _fileSize(0),
+        _filePos(0),
+        _isRegular(false),
+        _queueDepth(0),
+        _blockSize(1024*1024),
+        _directIO(false),
+        _readSize(0),
+        _readUnit(0),
+        _readPos(0),
+        _nextTag(0),
+        _readEof(false),
+        _readFailed(false),
+        _metadata(false),
+        _recordPos(0),
+        _startOffset(0),
+        _length(0),
+        _startPos(0),
+        _endPos(0),
+        _seekPending(false),
+        _seekIndex(0),
+        _sampleRate(1e6),
+        _pacing(false),
+        _paceCount(0),
+        _sendLabel(false)
     {
         this->setupOutput(0, dtype);
         this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setFilePath));
         this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setAutoRewind));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setMemoryMap));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setWindowSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setQueueDepth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setBlockSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setDirectIO));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setMetadata));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setStartOffset));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setLength));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setSampleRate));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, setPacing));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, seek));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, seekTime));
+        this->registerCall(this, POTHOS_FCN_TUPLE(BinaryFileSource, getPosition));
+        this->registerProbe("getPosition", "probePosition", "positionTriggered");
     }
 
     void setFilePath(const std::string &path)
@@ -83,24 +233,165 @@ public:
         _rewind = rewind;
     }
 
+    void setMemoryMap(const bool memoryMap)
+    {
+        #ifdef _MSC_VER
+        if (memoryMap) throw Pothos::NotImplementedException("BinaryFileSource::setMemoryMap()", "not supported on Windows");
+        #endif //_MSC_VER
+        _memoryMap = memoryMap;
+    }
+
+    void setWindowSize(const size_t windowSize)
+    {
+        if (windowSize == 0) throw Pothos::InvalidArgumentException("BinaryFileSource::setWindowSize()", "window size cannot be zero");
+        _windowSize = windowSize;
+    }
+
+    void setQueueDepth(const size_t queueDepth)
+    {
+        _queueDepth = queueDepth;
+    }
+
+    void setBlockSize(const size_t blockSize)
+    {
+        if (blockSize == 0) throw Pothos::InvalidArgumentException("BinaryFileSource::setBlockSize()", "block size cannot be zero");
+        _blockSize = blockSize;
+    }
+
+    void setDirectIO(const bool directIO)
+    {
+        _directIO = directIO;
+    }
+
+    void setMetadata(const bool metadata)
+    {
+        _metadata = metadata;
+    }
+
+    void setStartOffset(const unsigned long long startOffset)
+    {
+        _startOffset = startOffset;
+    }
+
+    void setLength(const unsigned long long length)
+    {
+        _length = length;
+    }
+
+    void setSampleRate(const double sampleRate)
+    {
+        if (sampleRate <= 0.0) throw Pothos::InvalidArgumentException("BinaryFileSource::setSampleRate()", "sample rate must be positive");
+        _sampleRate = sampleRate;
+        this->restartPacing();
+    }
+
+    void setPacing(const bool pacing)
+    {
+        _pacing = pacing;
+        this->restartPacing();
+    }
+
+    void seek(const unsigned long long index)
+    {
+        //not active: playback begins at this index when activated
+        if (_fd == -1)
+        {
+            _seekPending = true;
+            _seekIndex = index;
+            return;
+        }
+
+        const unsigned long long pos = index*this->output(0)->dtype().size();
+        if (pos > _endPos) throw Pothos::RangeException("BinaryFileSource::seek("+std::to_string(index)+")", "index is past the end of playback");
+        this->seekBytes(pos);
+        this->restartPacing();
+    }
+
+    void seekTime(const double seconds)
+    {
+        if (seconds < 0.0) throw Pothos::RangeException("BinaryFileSource::seekTime()", "time cannot be negative");
+        this->seek((unsigned long long)(seconds*_sampleRate + 0.5));
+    }
+
+    unsigned long long getPosition(void) const
+    {
+        return _filePos/this->output(0)->dtype().size();
+    }
+
     void activate(void)
     {
         if (_path.empty()) throw Pothos::FileException("BinaryFileSource", "empty file path");
-        _fd = open(_path.c_str(), O_RDONLY | O_BINARY);
+        const bool async = _queueDepth != 0 and not _memoryMap;
+        int flags = O_RDONLY | O_BINARY;
+        #ifdef O_DIRECT
+        if (async and _directIO) flags |= O_DIRECT;
+        #endif //O_DIRECT
+        _fd = open(_path.c_str(), flags);
+        #ifdef O_DIRECT
+        if (_fd < 0 and errno == EINVAL and (flags & O_DIRECT) != 0)
+        {
+            poco_warning_f1(Poco::Logger::get("BinaryFileSource"), "O_DIRECT not supported for %s, using the page cache", _path);
+            _fd = open(_path.c_str(), flags & ~O_DIRECT);
+        }
+        #endif //O_DIRECT
         if (_fd < 0)
         {
             poco_error_f4(Poco::Logger::get("BinaryFileSource"), "open(%s) returned %d -- %s(%d)", _path, _fd, std::string(strerror(errno)), errno);
         }
+
+        //the mapped windows are located by the file position
+        struct stat st;
+        const bool statOk = _fd >= 0 and fstat(_fd, &st) == 0;
+        _fileSize = statOk? (unsigned long long)(st.st_size) : 0;
+
+        //regular files are always readable, select() is only needed for pipes and devices
+        _isRegular = statOk and S_ISREG(st.st_mode);
+
+        //the playback window in bytes, without a length playback follows a growing file
+        const size_t elemSize = this->output(0)->dtype().size();
+        _startPos = _startOffset*elemSize;
+        _endPos = (_length == 0)? std::numeric_limits<unsigned long long>::max() : _startPos + _length*elemSize;
+        if (_isRegular and _length != 0) _endPos = std::min(_endPos, _fileSize);
+        _startPos = std::min(_startPos, _endPos);
+
+        _records.clear();
+        if (_metadata) _records = loadFileMetadata(fileMetadataPath(_path));
+
+        //reads cover whole pages and whole elements
+        if (async and _fd >= 0)
+        {
+            _readUnit = AsyncFileIO::ALIGNMENT;
+            while (_readUnit % elemSize != 0) _readUnit += AsyncFileIO::ALIGNMENT;
+            _readSize = ((_blockSize + _readUnit - 1)/_readUnit)*_readUnit;
+            _aio.reset(new AsyncFileIO(unsigned(_queueDepth)));
+        }
+
+        this->seekBytes(_seekPending? std::min(_seekIndex*elemSize, _endPos) : _startPos);
+        _seekPending = false;
+        this->restartPacing();
     }
 
     void deactivate(void)
     {
+        //reads in flight must complete before the buffers and file are released
+        _aio.reset();
+        _reads.clear();
+        _slots.clear();
         close(_fd);
         _fd = -1;
     }
 
     void work(void)
     {
+        //the number of elements that may be released now
+        const auto limit = this->pacedLimit();
+        if (limit == 0) return this->yield();
+
+        #ifndef _MSC_VER
+        if (_memoryMap) return this->workMapped(limit);
+        #endif //_MSC_VER
+        if (_aio) return this->workAsync(limit);
+
         #ifdef _MSC_VER
         //TODO use windows API to have timeout
         #else
@@ -115,24 +406,330 @@ public:
         FD_SET(_fd, &rset);
 
         //call select with timeout
-        if (::select(_fd+1, &rset, NULL, NULL, &tv) <= 0) return this->yield();
+        if (not _isRegular and ::select(_fd+1, &rset, NULL, NULL, &tv) <= 0) return this->yield();
         #endif
 
         auto out0 = this->output(0);
+        const size_t elemSize = out0->dtype().size();
+        const size_t length = this->nextLength(out0->buffer().length, limit);
         void *ptr = out0->buffer();
-        auto r = read(_fd, ptr, out0->buffer().length);
-        if (r == 0 and _rewind) lseek(_fd, 0, SEEK_SET);
-        if (r >= 0) out0->produce(size_t(r)/out0->dtype().size());
-        else
+        auto r = (length == 0)? 0 : read(_fd, ptr, length);
+        if (r == 0) this->postMetadata(0);
+        if (r == 0 and _rewind) this->seekBytes(_startPos);
+        if (r > 0) this->posted(size_t(r)/elemSize);
+        if (r >= 0) out0->produce(size_t(r)/elemSize);
+        if (r > 0) _filePos += size_t(r);
+        if (r < 0)
         {
             poco_error_f3(Poco::Logger::get("BinaryFileSource"), "read() returned %d -- %s(%d)", int(r), std::string(strerror(errno)), errno);
         }
     }
 
 private:
+
+    #ifndef _MSC_VER
+    /*!
+     * Map the next window of the file and post it without a copy.
+     * Each window has its own mapping which is unmapped
+     * once downstream blocks release the buffer.
+     */
+    void workMapped(const unsigned long long limit)
+    {
+        auto out0 = this->output(0);
+
+        //mappings end at the file size, check again if the file has grown
+        struct stat st;
+        if (_filePos >= _fileSize and fstat(_fd, &st) == 0) _fileSize = (unsigned long long)(st.st_size);
+        const auto endPos = std::min(_endPos, _fileSize);
+        if (_filePos >= endPos) this->postMetadata(0);
+        if (_filePos >= endPos and _rewind) this->seekBytes(_startPos);
+
+        //whole elements from the file position to the end of the window
+        const size_t elemSize = out0->dtype().size();
+        const size_t length = this->nextLength(size_t(std::min<unsigned long long>(_windowSize, endPos - std::min(endPos, _filePos))), limit);
+        if (length == 0) return; //end of file
+
+        //mappings must begin on a page boundary
+        static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        const auto mapOffset = (_filePos/pageSize)*pageSize;
+        const size_t mapLength = size_t(_filePos - mapOffset) + length;
+        void *addr = mmap(nullptr, mapLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, off_t(mapOffset));
+        if (addr == MAP_FAILED)
+        {
+            poco_error_f3(Poco::Logger::get("BinaryFileSource"), "mmap() returned %d -- %s(%d)", -1, std::string(strerror(errno)), errno);
+            return;
+        }
+
+        //read ahead in this window and the next window
+        madvise(addr, mapLength, MADV_SEQUENTIAL);
+        madvise(addr, mapLength, MADV_WILLNEED);
+        #ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(_fd, off_t(mapOffset + mapLength), off_t(_windowSize), POSIX_FADV_WILLNEED);
+        #endif
+
+        std::shared_ptr<void> container(addr, [mapLength](void *p){munmap(p, mapLength);});
+        Pothos::BufferChunk buff(Pothos::SharedBuffer(size_t(addr), mapLength, container));
+        buff.address += size_t(_filePos - mapOffset);
+        buff.length = length;
+        buff.dtype = out0->dtype();
+        this->posted(length/elemSize);
+        out0->postBuffer(std::move(buff));
+        _filePos += length;
+    }
+    #endif //_MSC_VER
+
+    /*!
+     * Keep the queue full of reads into aligned buffers,
+     * and post each completed block downstream in file order.
+     * A block is posted in parts when pacing limits the elements.
+     * A buffer is reused once downstream blocks release it.
+     */
+    void workAsync(unsigned long long limit)
+    {
+        auto out0 = this->output(0);
+
+        //queue reads until the queue is full or the end of file is found
+        while (not _readEof and _readPos < _endPos and _reads.size() < _queueDepth)
+        {
+            PendingRead read;
+            read.tag = _nextTag++;
+            read.slot = this->freeSlot();
+            read.offset = _readPos;
+            _slots[read.slot].busy = true;
+            _aio->read(_fd, reinterpret_cast<void *>(_slots[read.slot].buff.getAddress()), _readSize, _readPos, read.tag);
+            _readPos += _readSize;
+            _reads.push_back(read);
+        }
+
+        //wait for the oldest read, and collect other completions without waiting
+        bool wait = true;
+        unsigned long long tag = 0;
+        long result = 0;
+        while (not _reads.empty() and _aio->complete(tag, result, wait))
+        {
+            auto &read = _reads[size_t(tag - _reads.front().tag)];
+            read.done = true;
+            read.result = result;
+            wait = not _reads.front().done;
+        }
+
+        //post the completed reads in file order
+        const size_t elemSize = out0->dtype().size();
+        while (not _reads.empty() and _reads.front().done and limit != 0)
+        {
+            const auto &read = _reads.front();
+            //a failed read ends the file, the file position cannot move past it,
+            //so the later reads are discarded and their buffers are released
+            if (read.result < 0)
+            {
+                poco_error_f2(Poco::Logger::get("BinaryFileSource"), "read() returned %d -- %s", int(read.result), std::string(strerror(int(-read.result))));
+                _aio->drain();
+                _reads.clear();
+                for (auto &slot : _slots) slot.busy = false;
+                _readEof = true;
+                _readFailed = true;
+                break;
+            }
+
+            //a short read is the end of the file
+            if (size_t(read.result) < _readSize) _readEof = true;
+
+            //whole elements from the file position to the end of the block or window
+            const auto blockEnd = std::min(read.offset + size_t(read.result), _endPos);
+            const size_t avail = (blockEnd > _filePos)? size_t(((blockEnd - _filePos)/elemSize)*elemSize) : 0;
+            const size_t length = (limit < avail/elemSize)? size_t(limit*elemSize) : avail;
+            if (length != 0)
+            {
+                Pothos::BufferChunk buff(_slots[read.slot].buff);
+                buff.address += size_t(_filePos - read.offset);
+                buff.length = length;
+                buff.dtype = out0->dtype();
+                this->posted(length/elemSize);
+                out0->postBuffer(std::move(buff));
+                _filePos += length;
+                limit -= length/elemSize;
+            }
+            if (length != avail) break; //the rest of the block is not due yet
+            _slots[read.slot].busy = false;
+            _reads.pop_front();
+        }
+
+        //start again from the beginning once the reads past the end have completed
+        const bool atEnd = _reads.empty() and (_readEof or _readPos >= _endPos);
+        if (atEnd) this->postMetadata(0);
+        if (atEnd and _rewind) this->seekBytes(_startPos);
+
+        //without a length, the file may still grow, so read again from the file position
+        else if (atEnd and _length == 0 and not _readFailed)
+        {
+            _readPos = (_filePos/_readUnit)*_readUnit;
+            _readEof = false;
+        }
+    }
+
+    //the number of bytes to post next, limited by the window and the pacing
+    size_t nextLength(const size_t maxLength, const unsigned long long limit) const
+    {
+        const size_t elemSize = this->output(0)->dtype().size();
+        size_t length = size_t(std::min<unsigned long long>(maxLength, _endPos - _filePos));
+        if (limit < length/elemSize) length = size_t(limit*elemSize);
+        return (length/elemSize)*elemSize;
+    }
+
+    //move the playback position to a byte offset in the file
+    void seekBytes(const unsigned long long pos)
+    {
+        _filePos = pos;
+        if (_aio)
+        {
+            //reads begin on whole pages and whole elements
+            _aio->drain();
+            _reads.clear();
+            for (auto &slot : _slots) slot.busy = false;
+            _readPos = (pos/_readUnit)*_readUnit;
+            _readEof = false;
+            _readFailed = false;
+        }
+        else if (_fd >= 0 and not _memoryMap and _isRegular) lseek(_fd, off_t(pos), SEEK_SET);
+
+        //skip the metadata before the position
+        const unsigned long long index = pos/this->output(0)->dtype().size();
+        _recordPos = size_t(std::lower_bound(_records.begin(), _records.end(), index,
+            [](const FileMetadataRecord &record, const unsigned long long i){return record.index < i;}) - _records.begin());
+    }
+
+    void restartPacing(void)
+    {
+        _paceStart = std::chrono::steady_clock::now();
+        _paceCount = 0;
+        _sendLabel = _pacing;
+    }
+
+    /*!
+     * The number of elements that are due according to the sample rate.
+     * When no elements are due, wait until the deadline of the next element
+     * (limited by the work timeout) and return zero.
+     */
+    unsigned long long pacedLimit(void)
+    {
+        if (not _pacing) return std::numeric_limits<unsigned long long>::max();
+        const auto now = std::chrono::steady_clock::now();
+        const std::chrono::duration<double> elapsed(now - _paceStart);
+        const auto due = (unsigned long long)(elapsed.count()*_sampleRate) + 1;
+        if (due > _paceCount) return due - _paceCount;
+
+        const std::chrono::duration<double> nextTime(_paceCount/_sampleRate);
+        const auto deadline = _paceStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(nextTime);
+        const auto timeout = now + std::chrono::nanoseconds(this->workInfo().maxTimeoutNs);
+        std::this_thread::sleep_until(std::min(deadline, timeout));
+        return 0;
+    }
+
+    //post the metadata for the elements about to be posted, and count them for pacing
+    void posted(const size_t elements)
+    {
+        if (_sendLabel) this->output(0)->postLabel(Pothos::Label("rxRate", _sampleRate, 0));
+        _sendLabel = false;
+        this->postMetadata(elements);
+        _paceCount += elements;
+    }
+
+    /*!
+     * Post the recorded labels within the next elements of the stream,
+     * and the messages that were recorded before the end of those elements.
+     * At the end of the file, zero elements posts the remaining messages.
+     */
+    void postMetadata(const size_t elements)
+    {
+        auto out0 = this->output(0);
+        const unsigned long long begin = _filePos/out0->dtype().size();
+        const unsigned long long end = begin + elements;
+        for (; _recordPos < _records.size(); _recordPos++)
+        {
+            const auto &record = _records[_recordPos];
+            const bool isLabel = record.type == FileMetadataRecord::LABEL;
+            if (record.index >= end and (isLabel or record.index > begin)) break;
+            if (isLabel)
+            {
+                auto label = record.object.extract<Pothos::Label>();
+                label.index -= std::min(label.index, begin);
+                out0->postLabel(label);
+            }
+            else if (record.type == FileMetadataRecord::MESSAGE) out0->postMessage(record.object);
+            else if (record.object.extract<Pothos::DType>().size() != out0->dtype().size())
+            {
+                poco_warning_f2(Poco::Logger::get("BinaryFileSource"), "recorded data type %s does not match %s",
+                    record.object.extract<Pothos::DType>().toString(), out0->dtype().toString());
+            }
+        }
+    }
+
+    //find a buffer that is not in flight and not held downstream, or allocate one
+    size_t freeSlot(void)
+    {
+        for (size_t i = 0; i < _slots.size(); i++)
+        {
+            if (not _slots[i].busy and _slots[i].buff.unique()) return i;
+        }
+
+        const auto container = AsyncFileIO::allocate(_readSize);
+        ReadSlot slot;
+        slot.buff = Pothos::SharedBuffer(size_t(container.get()), _readSize, container);
+        _slots.push_back(slot);
+        return _slots.size()-1;
+    }
+
+    struct ReadSlot
+    {
+        ReadSlot(void): busy(false){}
+        Pothos::SharedBuffer buff;
+        bool busy;
+    };
+
+    struct PendingRead
+    {
+        PendingRead(void): tag(0), slot(0), offset(0), result(0), done(false){}
+        unsigned long long tag;
+        size_t slot;
+        unsigned long long offset;
+        long result;
+        bool done;
+    };
+
     int _fd;
     std::string _path;
     bool _rewind;
+    bool _memoryMap;
+    size_t _windowSize;
+    unsigned long long _fileSize;
+    unsigned long long _filePos;
+    bool _isRegular;
+    size_t _queueDepth;
+    size_t _blockSize;
+    bool _directIO;
+    size_t _readSize;
+    size_t _readUnit;
+    unsigned long long _readPos;
+    std::unique_ptr<AsyncFileIO> _aio;
+    std::vector<ReadSlot> _slots;
+    std::deque<PendingRead> _reads;
+    unsigned long long _nextTag;
+    bool _readEof;
+    bool _readFailed;
+    bool _metadata;
+    std::vector<FileMetadataRecord> _records;
+    size_t _recordPos;
+    unsigned long long _startOffset;
+    unsigned long long _length;
+    unsigned long long _startPos;
+    unsigned long long _endPos;
+    bool _seekPending;
+    unsigned long long _seekIndex;
+    double _sampleRate;
+    bool _pacing;
+    std::chrono::steady_clock::time_point _paceStart;
+    unsigned long long _paceCount;
+    bool _sendLabel;
 };
 
 static Pothos::BlockRegistry registerBinaryFileSource(
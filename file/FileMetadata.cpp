@@ -0,0 +1,95 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "FileMetadata.hpp"
+#include <Poco/ByteOrder.h>
+#include <Poco/Types.h>
+#include <Poco/Format.h>
+#include <sstream>
+#include <cstring>
+
+/***********************************************************************
+ * Sidecar file: magic, followed by records of
+ * type (1 byte), element index (8 bytes), length (4 bytes),
+ * and the serialized object, all in network byte order
+ **********************************************************************/
+static const char METADATA_MAGIC[8] = {'P', 'T', 'H', 'M', 'E', 'T', 'A', '1'};
+static const size_t RECORD_HDR_BYTES = 13;
+
+std::string fileMetadataPath(const std::string &recordingPath)
+{
+    return recordingPath + ".meta";
+}
+
+std::string numberedFilePath(const std::string &recordingPath, const unsigned long long number)
+{
+    const auto sep = recordingPath.find_last_of("/\\");
+    auto dot = recordingPath.rfind('.');
+    if (dot == std::string::npos or (sep != std::string::npos and dot < sep)) dot = recordingPath.size();
+    return recordingPath.substr(0, dot) + Poco::format("_%04u", unsigned(number)) + recordingPath.substr(dot);
+}
+
+FileMetadataWriter::FileMetadataWriter(const std::string &path):
+    _streamBuffer(1024*1024)
+{
+    _file.rdbuf()->pubsetbuf(_streamBuffer.data(), _streamBuffer.size());
+    _file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    _file.write(METADATA_MAGIC, sizeof(METADATA_MAGIC));
+    if (not _file) throw Pothos::FileException("FileMetadataWriter("+path+")", "open failed");
+}
+
+void FileMetadataWriter::write(const FileMetadataRecord::Type type, const unsigned long long index, const Pothos::Object &object)
+{
+    std::ostringstream ss;
+    object.serialize(ss);
+    const auto payload = ss.str();
+
+    char hdr[RECORD_HDR_BYTES];
+    hdr[0] = char(type);
+    const Poco::UInt64 indexN = Poco::ByteOrder::toNetwork(Poco::UInt64(index));
+    const Poco::UInt32 lengthN = Poco::ByteOrder::toNetwork(Poco::UInt32(payload.size()));
+    std::memcpy(hdr+1, &indexN, sizeof(indexN));
+    std::memcpy(hdr+9, &lengthN, sizeof(lengthN));
+    _file.write(hdr, sizeof(hdr));
+    _file.write(payload.data(), payload.size());
+}
+
+void FileMetadataWriter::flush(void)
+{
+    _file.flush();
+    if (not _file) throw Pothos::FileException("FileMetadataWriter::flush()", "write failed");
+}
+
+std::vector<FileMetadataRecord> loadFileMetadata(const std::string &path)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (not file) throw Pothos::FileException("loadFileMetadata("+path+")", "open failed");
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    #define metaCheck(cond) if (not (cond)) throw Pothos::DataFormatException("loadFileMetadata("+path+")", "failed check: " #cond)
+    metaCheck(data.size() >= sizeof(METADATA_MAGIC));
+    metaCheck(std::memcmp(data.data(), METADATA_MAGIC, sizeof(METADATA_MAGIC)) == 0);
+
+    std::vector<FileMetadataRecord> records;
+    size_t pos = sizeof(METADATA_MAGIC);
+    while (pos != data.size())
+    {
+        metaCheck(data.size() - pos >= RECORD_HDR_BYTES);
+        Poco::UInt64 index = 0;
+        Poco::UInt32 length = 0;
+        std::memcpy(&index, data.data()+pos+1, sizeof(index));
+        std::memcpy(&length, data.data()+pos+9, sizeof(length));
+        length = Poco::ByteOrder::fromNetwork(length);
+        metaCheck(data.size() - pos - RECORD_HDR_BYTES >= length);
+
+        FileMetadataRecord record;
+        record.type = FileMetadataRecord::Type(data[pos]);
+        metaCheck(record.type == FileMetadataRecord::DTYPE or record.type == FileMetadataRecord::LABEL or record.type == FileMetadataRecord::MESSAGE);
+        record.index = Poco::ByteOrder::fromNetwork(index);
+        std::istringstream ss(data.substr(pos+RECORD_HDR_BYTES, length));
+        record.object.deserialize(ss);
+        records.push_back(record);
+        pos += RECORD_HDR_BYTES + length;
+    }
+    return records;
+}
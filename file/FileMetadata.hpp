@@ -0,0 +1,71 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Framework.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*!
+ * One record in the metadata sidecar of a binary recording.
+ * Records are stored in stream order, so the element indexes never decrease.
+ */
+struct FileMetadataRecord
+{
+    enum Type
+    {
+        DTYPE = 'D', //!< the data type of the elements that follow
+        LABEL = 'L', //!< a label, the label index is the absolute element index
+        MESSAGE = 'M' //!< a message that arrived after index elements
+    };
+
+    FileMetadataRecord(void):
+        type(MESSAGE),
+        index(0)
+    {
+        return;
+    }
+
+    Type type;
+
+    //! The absolute element index of the record
+    unsigned long long index;
+
+    //! The data type, label, or message
+    Pothos::Object object;
+};
+
+//! The path of the metadata sidecar file for a recording
+std::string fileMetadataPath(const std::string &recordingPath);
+
+//! The path of a numbered file of a recording, the number is inserted before the extension
+std::string numberedFilePath(const std::string &recordingPath, const unsigned long long number);
+
+/*!
+ * Write the metadata sidecar of a recording.
+ * The records are buffered and written to the file in large chunks,
+ * and each record holds the element index for seeking.
+ */
+class FileMetadataWriter
+{
+public:
+    //! Create or truncate the sidecar, throws on error
+    FileMetadataWriter(const std::string &path);
+
+    void write(const FileMetadataRecord::Type type, const unsigned long long index, const Pothos::Object &object);
+
+    //! Write the buffered records to the file
+    void flush(void);
+
+private:
+    std::ofstream _file;
+    std::vector<char> _streamBuffer;
+};
+
+/*!
+ * Read all records of a metadata sidecar.
+ * Throws Pothos::FileException when the file cannot be read,
+ * and Pothos::DataFormatException when a record is malformed.
+ */
+std::vector<FileMetadataRecord> loadFileMetadata(const std::string &path);
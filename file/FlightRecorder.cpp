@@ -0,0 +1,410 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "AsyncFileIO.hpp"
+#include "FileMetadata.hpp"
+#include <Pothos/Framework.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif //_MSC_VER
+#include <cerrno>
+#include <cstring>
+#include <algorithm> //min
+#include <memory>
+#include <future>
+#include <chrono>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#ifdef _MSC_VER
+#define MY_S_IREADWRITE _S_IREAD | _S_IWRITE
+#else
+#define MY_S_IREADWRITE S_IRUSR | S_IWUSR
+#endif
+
+#include <Poco/Logger.h>
+
+/***********************************************************************
+ * |PothosDoc Flight Recorder
+ *
+ * The flight recorder keeps the most recent input stream in an in-memory ring,
+ * and writes the stream around a trigger event to a file.
+ * Each capture contains the pre-trigger window from the ring,
+ * followed by the post-trigger window from the input stream.
+ * The capture files are written in the background,
+ * so that the input stream is not held up by the storage device.
+ *
+ * Captures are numbered, and the number is inserted before the extension of the file path:
+ * for example, "capture.dat" is recorded as "capture_0000.dat", "capture_0001.dat", and so on.
+ *
+ * <h2>Triggers</h2>
+ *
+ * A capture is triggered by an input label with the specified ID,
+ * or by calling the trigger slot, as with the triggered signal block.
+ * Triggers during the post-trigger window of a capture are ignored.
+ * Two captures can be written in the background at once;
+ * a trigger is dropped with a warning when both are still being written.
+ *
+ * <h2>Memory</h2>
+ *
+ * The ring and capture buffers are allocated and touched when the block is activated,
+ * so the window sizes take effect on the next activation.
+ * Huge pages reduce TLB misses for large windows, and require huge pages
+ * to be reserved by the system (for example, with vm.nr_hugepages on Linux).
+ * When huge pages are not available, regular pages are used.
+ *
+ * |category /Sinks
+ * |category /File IO
+ * |keywords sink binary file capture trigger ring record
+ *
+ * |param dtype[Data Type] The input data type.
+ * |widget DTypeChooser(float=1,cfloat=1,int=1,cint=1,uint=1,cuint=1,dim=1)
+ * |default "complex_float64"
+ * |preview disable
+ *
+ * |param path[File Path] The path to the capture files.
+ * |default ""
+ * |widget FileEntry(mode=save)
+ *
+ * |param units[Units] The units of the pre-trigger and post-trigger windows.
+ * |default "SECONDS"
+ * |option [Seconds] "SECONDS"
+ * |option [Bytes] "BYTES"
+ * |preview valid
+ *
+ * |param sampleRate[Sample Rate] The sample rate of the input stream.
+ * The sample rate converts windows in seconds to a number of elements.
+ * |default 1e6
+ * |units samples/sec
+ * |preview valid
+ *
+ * |param preTrigger[Pre-Trigger] The size of the window before the trigger.
+ * |default 1.0
+ * |preview valid
+ *
+ * |param postTrigger[Post-Trigger] The size of the window after the trigger.
+ * |default 1.0
+ * |preview valid
+ *
+ * |param labelTrigger[Label Trigger] A label ID to match for trigger events.
+ * |widget StringEntry()
+ * |default ""
+ * |preview valid
+ *
+ * |param hugePages[Huge Pages] Back the ring and capture buffers with huge pages.
+ * Huge pages are only supported on Linux, and the option is ignored elsewhere.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |factory /blocks/flight_recorder(dtype)
+ * |setter setFilePath(path)
+ * |setter setUnits(units)
+ * |setter setSampleRate(sampleRate)
+ * |setter setPreTrigger(preTrigger)
+ * |setter setPostTrigger(postTrigger)
+ * |setter setLabelTrigger(labelTrigger)
+ * |setter setHugePages(hugePages)
+ **********************************************************************/
+class FlightRecorder : public Pothos::Block
+{
+public:
+    static Block *make(const Pothos::DType &dtype)
+    {
+        return new FlightRecorder(dtype);
+    }
+
+    FlightRecorder(const Pothos::DType &dtype):
+        _units("SECONDS"),
+        _sampleRate(1e6),
+        _preTrigger(1.0),
+        _postTrigger(1.0),
+        _hugePages(false),
+        _preBytes(0),
+        _postBytes(0),
+        _ringPos(0),
+        _ringFill(0),
+        _active(NONE),
+        _postRemaining(0),
+        _captureCount(0)
+    {
+        this->setupInput(0, dtype);
+        this->registerSlot("trigger");
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setFilePath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setUnits));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setSampleRate));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setPreTrigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setPostTrigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setLabelTrigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, setHugePages));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, trigger));
+        this->registerCall(this, POTHOS_FCN_TUPLE(FlightRecorder, getCaptureCount));
+        this->registerProbe("getCaptureCount", "probeCaptureCount", "captureCountTriggered");
+    }
+
+    void setFilePath(const std::string &path)
+    {
+        _path = path;
+    }
+
+    void setUnits(const std::string &units)
+    {
+        if (units != "SECONDS" and units != "BYTES") throw Pothos::InvalidArgumentException("FlightRecorder::setUnits("+units+")", "unknown units");
+        _units = units;
+    }
+
+    void setSampleRate(const double sampleRate)
+    {
+        if (sampleRate <= 0.0) throw Pothos::InvalidArgumentException("FlightRecorder::setSampleRate()", "sample rate must be positive");
+        _sampleRate = sampleRate;
+    }
+
+    void setPreTrigger(const double preTrigger)
+    {
+        if (preTrigger < 0.0) throw Pothos::InvalidArgumentException("FlightRecorder::setPreTrigger()", "window cannot be negative");
+        _preTrigger = preTrigger;
+    }
+
+    void setPostTrigger(const double postTrigger)
+    {
+        if (postTrigger < 0.0) throw Pothos::InvalidArgumentException("FlightRecorder::setPostTrigger()", "window cannot be negative");
+        _postTrigger = postTrigger;
+    }
+
+    void setLabelTrigger(const std::string &labelTrigger)
+    {
+        _labelTrigger = labelTrigger;
+    }
+
+    void setHugePages(const bool hugePages)
+    {
+        _hugePages = hugePages;
+    }
+
+    unsigned long long getCaptureCount(void) const
+    {
+        return _captureCount;
+    }
+
+    void activate(void)
+    {
+        if (_path.empty()) throw Pothos::FileException("FlightRecorder", "empty file path");
+        _preBytes = this->windowBytes(_preTrigger);
+        _postBytes = this->windowBytes(_postTrigger);
+        if (_preBytes + _postBytes == 0) throw Pothos::InvalidArgumentException("FlightRecorder", "empty capture window");
+
+        _ring.reset();
+        if (_preBytes != 0) _ring = this->allocate(_preBytes);
+        for (auto &capture : _captures)
+        {
+            capture.mem = this->allocate(_preBytes + _postBytes);
+            capture.length = 0;
+        }
+        _ringPos = 0;
+        _ringFill = 0;
+        _active = NONE;
+        _captureCount = 0;
+    }
+
+    void deactivate(void)
+    {
+        //the capture in progress keeps the part of the post-trigger window that arrived
+        if (_active != NONE) this->finishCapture();
+        for (auto &capture : _captures)
+        {
+            if (capture.written.valid()) capture.written.wait();
+            capture.written = std::future<void>();
+            capture.mem.reset();
+        }
+        _ring.reset();
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+
+        //messages are not recorded
+        while (in0->hasMessage()) in0->popMessage();
+
+        const size_t available = in0->elements();
+        if (available == 0) return;
+        const size_t elemSize = in0->dtype().size();
+        const char *ptr = in0->buffer();
+
+        //record up to each matching label, and trigger at the label
+        size_t done = 0;
+        for (const auto &label : in0->labels())
+        {
+            if (label.index >= available) break;
+            if (_labelTrigger.empty() or label.id != _labelTrigger) continue;
+            this->record(ptr + done*elemSize, (label.index - done)*elemSize);
+            done = label.index;
+            this->trigger();
+        }
+        this->record(ptr + done*elemSize, (available - done)*elemSize);
+        in0->consume(available);
+    }
+
+    //trigger slot and used internally for label triggers
+    void trigger(void)
+    {
+        if (not this->isActive() or _active != NONE) return;
+
+        //use a capture buffer that is not being written
+        for (size_t i = 0; i < NUM_CAPTURES; i++)
+        {
+            auto &capture = _captures[i];
+            if (capture.written.valid() and capture.written.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+            if (capture.written.valid()) capture.written.get();
+
+            //copy the ring from the oldest byte to the newest
+            char *dst = static_cast<char *>(capture.mem.get());
+            const char *ring = static_cast<const char *>(_ring.get());
+            const size_t start = (_ringPos + _preBytes - _ringFill) % (_preBytes == 0? 1 : _preBytes);
+            const size_t first = std::min(_ringFill, _preBytes - start);
+            if (first != 0) std::memcpy(dst, ring + start, first);
+            if (_ringFill != first) std::memcpy(dst + first, ring, _ringFill - first);
+            capture.length = _ringFill;
+
+            _active = i;
+            _postRemaining = _postBytes;
+            if (_postRemaining == 0) this->finishCapture();
+            return;
+        }
+
+        poco_warning_f1(Poco::Logger::get("FlightRecorder"), "capture %s dropped -- previous captures are still being written",
+            numberedFilePath(_path, _captureCount));
+    }
+
+private:
+
+    static const size_t NUM_CAPTURES = 2;
+    static const size_t NONE = size_t(~0);
+
+    size_t windowBytes(const double window) const
+    {
+        const size_t elemSize = this->input(0)->dtype().size();
+        if (_units == "BYTES") return (size_t(window)/elemSize)*elemSize;
+        return size_t(window*_sampleRate)*elemSize;
+    }
+
+    //allocate and touch the pages up front so that recording does not fault them in
+    std::shared_ptr<void> allocate(const size_t size) const
+    {
+        #ifdef MAP_HUGETLB
+        if (_hugePages)
+        {
+            const size_t hugePageSize = 2*1024*1024;
+            const size_t length = ((size + hugePageSize - 1)/hugePageSize)*hugePageSize;
+            void *mem = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            if (mem != MAP_FAILED) return std::shared_ptr<void>(mem, [length](void *p){munmap(p, length);});
+            poco_warning_f2(Poco::Logger::get("FlightRecorder"), "huge page allocation of %z bytes failed -- %s, using regular pages",
+                length, std::string(strerror(errno)));
+        }
+        #endif //MAP_HUGETLB
+        auto mem = AsyncFileIO::allocate(size);
+        std::memset(mem.get(), 0, size);
+        return mem;
+    }
+
+    //copy into the capture in progress and the ring
+    void record(const char *ptr, const size_t length)
+    {
+        if (length == 0) return;
+
+        if (_active != NONE)
+        {
+            auto &capture = _captures[_active];
+            const size_t n = std::min(length, _postRemaining);
+            std::memcpy(static_cast<char *>(capture.mem.get()) + capture.length, ptr, n);
+            capture.length += n;
+            _postRemaining -= n;
+            if (_postRemaining == 0) this->finishCapture();
+        }
+
+        if (_preBytes == 0) return;
+        char *ring = static_cast<char *>(_ring.get());
+        if (length >= _preBytes)
+        {
+            std::memcpy(ring, ptr + length - _preBytes, _preBytes);
+            _ringPos = 0;
+            _ringFill = _preBytes;
+            return;
+        }
+        const size_t first = std::min(length, _preBytes - _ringPos);
+        std::memcpy(ring + _ringPos, ptr, first);
+        std::memcpy(ring, ptr + first, length - first);
+        _ringPos = (_ringPos + length) % _preBytes;
+        _ringFill = std::min(_ringFill + length, _preBytes);
+    }
+
+    //write the capture to its file in the background
+    void finishCapture(void)
+    {
+        auto &capture = _captures[_active];
+        capture.written = std::async(std::launch::async, &FlightRecorder::writeCapture,
+            numberedFilePath(_path, _captureCount++), capture.mem, capture.length);
+        _active = NONE;
+    }
+
+    static void writeCapture(const std::string &path, std::shared_ptr<void> mem, const size_t length)
+    {
+        const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, MY_S_IREADWRITE);
+        if (fd < 0)
+        {
+            poco_error_f4(Poco::Logger::get("FlightRecorder"), "open(%s) returned %d -- %s(%d)", path, fd, std::string(strerror(errno)), errno);
+            return;
+        }
+        const char *ptr = static_cast<const char *>(mem.get());
+        size_t written = 0;
+        while (written < length)
+        {
+            const auto r = write(fd, ptr + written, length - written);
+            if (r < 0)
+            {
+                poco_error_f3(Poco::Logger::get("FlightRecorder"), "write() returned %d -- %s(%d)", int(r), std::string(strerror(errno)), errno);
+                break;
+            }
+            written += size_t(r);
+        }
+        close(fd);
+    }
+
+    struct Capture
+    {
+        Capture(void): length(0){}
+        std::shared_ptr<void> mem;
+        size_t length;
+        std::future<void> written;
+    };
+
+    std::string _path;
+    std::string _units;
+    double _sampleRate;
+    double _preTrigger;
+    double _postTrigger;
+    std::string _labelTrigger;
+    bool _hugePages;
+    size_t _preBytes;
+    size_t _postBytes;
+    std::shared_ptr<void> _ring;
+    size_t _ringPos;
+    size_t _ringFill;
+    Capture _captures[NUM_CAPTURES];
+    size_t _active;
+    size_t _postRemaining;
+    unsigned long long _captureCount;
+};
+
+static Pothos::BlockRegistry registerFlightRecorder(
+    "/blocks/flight_recorder", &FlightRecorder::make);
@@ -0,0 +1,96 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "StripedFile.hpp"
+#include <Pothos/Framework.hpp>
+#include <Poco/Logger.h>
+#include <json.hpp>
+#include <fstream>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#define MY_S_IREADWRITE _S_IREAD | _S_IWRITE
+#else
+#include <unistd.h>
+#define MY_S_IREADWRITE S_IRUSR | S_IWUSR
+#endif //_MSC_VER
+
+using json = nlohmann::json;
+
+static const int MANIFEST_VERSION = 1;
+
+unsigned long long StripedManifest::fileBytes(const size_t index) const
+{
+    const size_t numFiles = paths.size();
+    const unsigned long long fullStripes = totalBytes/stripeSize;
+    const size_t remainder = size_t(totalBytes%stripeSize);
+    unsigned long long bytes = (fullStripes/numFiles)*stripeSize;
+    if (index < fullStripes%numFiles) bytes += stripeSize;
+    if (index == fullStripes%numFiles) bytes += remainder;
+    return bytes;
+}
+
+void saveStripedManifest(const std::string &path, const StripedManifest &manifest)
+{
+    json j;
+    j["version"] = MANIFEST_VERSION;
+    j["paths"] = manifest.paths;
+    j["stripeSize"] = manifest.stripeSize;
+    j["totalBytes"] = manifest.totalBytes;
+    j["dtype"] = manifest.dtype;
+    j["dimension"] = manifest.dimension;
+
+    std::ofstream file(path.c_str(), std::ios::trunc);
+    file << j.dump(4) << std::endl;
+    if (not file) throw Pothos::FileException("saveStripedManifest("+path+")", "write failed");
+}
+
+StripedManifest loadStripedManifest(const std::string &path)
+{
+    std::ifstream file(path.c_str());
+    if (not file) throw Pothos::FileException("loadStripedManifest("+path+")", "open failed");
+
+    StripedManifest manifest;
+    try
+    {
+        json j;
+        file >> j;
+        if (j["version"].get<int>() != MANIFEST_VERSION) throw Pothos::DataFormatException(
+            "loadStripedManifest("+path+")", "unsupported version");
+        manifest.paths = j["paths"].get<std::vector<std::string>>();
+        manifest.stripeSize = j["stripeSize"].get<size_t>();
+        manifest.totalBytes = j["totalBytes"].get<unsigned long long>();
+        manifest.dtype = j["dtype"].get<std::string>();
+        manifest.dimension = j["dimension"].get<size_t>();
+    }
+    catch (const std::exception &ex)
+    {
+        throw Pothos::DataFormatException("loadStripedManifest("+path+")", ex.what());
+    }
+
+    if (manifest.paths.empty()) throw Pothos::DataFormatException("loadStripedManifest("+path+")", "no stripe files");
+    if (manifest.stripeSize == 0) throw Pothos::DataFormatException("loadStripedManifest("+path+")", "stripe size is zero");
+    return manifest;
+}
+
+int openStripeFile(const std::string &path, int flags, const bool directIO)
+{
+    #ifdef O_DIRECT
+    if (directIO) flags |= O_DIRECT;
+    #else
+    (void)directIO;
+    #endif //O_DIRECT
+    int fd = open(path.c_str(), flags, MY_S_IREADWRITE);
+    #ifdef O_DIRECT
+    if (fd < 0 and errno == EINVAL and (flags & O_DIRECT) != 0)
+    {
+        poco_warning_f1(Poco::Logger::get("StripedFile"), "O_DIRECT not supported for %s, using the page cache", path);
+        fd = open(path.c_str(), flags & ~O_DIRECT, MY_S_IREADWRITE);
+    }
+    #endif //O_DIRECT
+    return fd;
+}
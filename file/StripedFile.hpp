@@ -0,0 +1,52 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+/*!
+ * The manifest of a striped recording.
+ * The stream is split into stripes of a fixed size,
+ * and stripe k is stored in file k % N at offset (k / N) * stripeSize.
+ */
+struct StripedManifest
+{
+    StripedManifest(void):
+        stripeSize(0),
+        totalBytes(0),
+        dimension(1)
+    {
+        return;
+    }
+
+    //! The paths of the stripe files in stripe order
+    std::vector<std::string> paths;
+
+    //! The number of bytes in each stripe
+    size_t stripeSize;
+
+    //! The number of bytes in the recorded stream
+    unsigned long long totalBytes;
+
+    //! The data type name and dimension of the recorded stream
+    std::string dtype;
+    size_t dimension;
+
+    //! The number of bytes stored in the file at the index
+    unsigned long long fileBytes(const size_t index) const;
+};
+
+//! Write the manifest as JSON, throws on error
+void saveStripedManifest(const std::string &path, const StripedManifest &manifest);
+
+//! Read the manifest from JSON, throws on error
+StripedManifest loadStripedManifest(const std::string &path);
+
+/*!
+ * Open a stripe file with the given flags,
+ * adding O_DIRECT when requested and supported by the filesystem.
+ * Returns a negative value on error, with errno set.
+ */
+int openStripeFile(const std::string &path, int flags, const bool directIO);
@@ -0,0 +1,244 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "AsyncFileIO.hpp"
+#include "StripedFile.hpp"
+#include <Pothos/Framework.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#define ftruncate _chsize_s
+#else
+#include <unistd.h>
+#endif //_MSC_VER
+#include <cerrno>
+#include <cstring>
+#include <algorithm> //min
+#include <memory>
+#include <vector>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include <Poco/Logger.h>
+
+/***********************************************************************
+ * |PothosDoc Striped File Sink
+ *
+ * Read streaming data from port 0 and write it across multiple files,
+ * such as files on separate drives, to exceed the bandwidth of a single drive.
+ * The stream is split into stripes of a fixed size, and the stripes
+ * are written to the files in round-robin order with asynchronous I/O.
+ * Stripe k is written to file k % N at offset (k / N) * stripeSize.
+ *
+ * A JSON manifest lists the files, the stripe size, the stream length, and the data type.
+ * The manifest is written when the block is deactivated,
+ * and the striped file source uses it to reassemble the stream.
+ * Messages are consumed and discarded.
+ *
+ * |category /Sinks
+ * |category /File IO
+ * |keywords sink binary file stripe raid
+ *
+ * |param manifest[Manifest Path] The path to the JSON manifest file.
+ * |default ""
+ * |widget FileEntry(mode=save)
+ *
+ * |param paths[File Paths] The paths of the stripe files, one for each drive.
+ * |default []
+ *
+ * |param stripeSize[Stripe Size] The number of bytes in each stripe.
+ * The size is rounded up to a multiple of the page size,
+ * and it should be a multiple of the element size.
+ * |default 1048576
+ * |units bytes
+ * |preview valid
+ *
+ * |param queueDepth[Queue Depth] The number of writes to keep in flight for each file.
+ * |default 4
+ * |preview valid
+ *
+ * |param directIO[Direct I/O] Bypass the page cache for the stripe files.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |factory /blocks/striped_file_sink()
+ * |setter setManifestPath(manifest)
+ * |setter setFilePaths(paths)
+ * |setter setStripeSize(stripeSize)
+ * |setter setQueueDepth(queueDepth)
+ * |setter setDirectIO(directIO)
+ **********************************************************************/
+class StripedFileSink : public Pothos::Block
+{
+public:
+    static Block *make(void)
+    {
+        return new StripedFileSink();
+    }
+
+    StripedFileSink(void):
+        _stripeSize(1024*1024),
+        _queueDepth(4),
+        _directIO(false),
+        _stripeIndex(0),
+        _totalBytes(0)
+    {
+        this->setupInput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSink, setManifestPath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSink, setFilePaths));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSink, setStripeSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSink, setQueueDepth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSink, setDirectIO));
+    }
+
+    void setManifestPath(const std::string &path)
+    {
+        _manifestPath = path;
+    }
+
+    void setFilePaths(const std::vector<std::string> &paths)
+    {
+        _paths = paths;
+    }
+
+    void setStripeSize(const size_t stripeSize)
+    {
+        if (stripeSize == 0) throw Pothos::InvalidArgumentException("StripedFileSink::setStripeSize()", "stripe size cannot be zero");
+        _stripeSize = stripeSize;
+    }
+
+    void setQueueDepth(const size_t queueDepth)
+    {
+        if (queueDepth == 0) throw Pothos::InvalidArgumentException("StripedFileSink::setQueueDepth()", "queue depth cannot be zero");
+        _queueDepth = queueDepth;
+    }
+
+    void setDirectIO(const bool directIO)
+    {
+        _directIO = directIO;
+    }
+
+    void activate(void)
+    {
+        if (_manifestPath.empty()) throw Pothos::FileException("StripedFileSink", "empty manifest path");
+        if (_paths.empty()) throw Pothos::InvalidArgumentException("StripedFileSink", "no stripe file paths");
+
+        //every stripe file is needed to reassemble the stream
+        for (const auto &path : _paths)
+        {
+            const int fd = openStripeFile(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, _directIO);
+            if (fd < 0)
+            {
+                const std::string error(strerror(errno));
+                this->closeFiles();
+                throw Pothos::FileException("StripedFileSink::activate("+path+")", error);
+            }
+            _fds.push_back(fd);
+        }
+
+        //one stripe is filled while the others are in flight
+        _writer.reset(new AsyncFileWriter(_queueDepth*_fds.size(), _stripeSize));
+        _stripeIndex = 0;
+        _totalBytes = 0;
+        _dtype = Pothos::DType();
+    }
+
+    void deactivate(void)
+    {
+        if (not _writer) return;
+
+        //write the partial stripe, padded to whole pages for direct I/O
+        if (_writer->fillBytes() != 0) this->writeStripe();
+        _writer->flush();
+        const size_t stripeBytes = _writer->blockSize();
+        _writer.reset();
+
+        StripedManifest manifest;
+        manifest.paths = _paths;
+        manifest.stripeSize = stripeBytes;
+        manifest.totalBytes = _totalBytes;
+        manifest.dtype = _dtype.name();
+        manifest.dimension = _dtype.dimension();
+
+        //remove the padding from the end of each file
+        for (size_t i = 0; i < _fds.size(); i++)
+        {
+            if (ftruncate(_fds[i], off_t(manifest.fileBytes(i))) != 0)
+            {
+                poco_error_f3(Poco::Logger::get("StripedFileSink"), "ftruncate() returned %d -- %s(%d)", -1, std::string(strerror(errno)), errno);
+            }
+        }
+        this->closeFiles();
+
+        try
+        {
+            saveStripedManifest(_manifestPath, manifest);
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            poco_error(Poco::Logger::get("StripedFileSink"), ex.displayText());
+        }
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        while (in0->hasMessage()) in0->popMessage();
+        if (in0->elements() == 0) return;
+
+        //the data type is recorded in the manifest
+        if (_totalBytes == 0) _dtype = in0->buffer().dtype;
+
+        const char *ptr = in0->buffer();
+        const size_t length = in0->elements();
+        size_t offset = 0;
+        while (offset < length)
+        {
+            offset += _writer->fill(ptr + offset, length - offset);
+            if (_writer->full()) this->writeStripe();
+        }
+        in0->consume(length);
+        _totalBytes += length;
+
+        //release the completed writes without waiting
+        _writer->reap(false);
+    }
+
+private:
+
+    //submit the stripe being filled to its file
+    void writeStripe(void)
+    {
+        const size_t file = size_t(_stripeIndex % _fds.size());
+        const unsigned long long offset = (_stripeIndex / _fds.size())*_writer->blockSize();
+        _writer->write(_fds[file], offset);
+        _stripeIndex++;
+    }
+
+    void closeFiles(void)
+    {
+        for (const auto fd : _fds) close(fd);
+        _fds.clear();
+    }
+
+    std::string _manifestPath;
+    std::vector<std::string> _paths;
+    size_t _stripeSize;
+    size_t _queueDepth;
+    bool _directIO;
+    std::vector<int> _fds;
+    std::unique_ptr<AsyncFileWriter> _writer;
+    unsigned long long _stripeIndex;
+    unsigned long long _totalBytes;
+    Pothos::DType _dtype;
+};
+
+static Pothos::BlockRegistry registerStripedFileSink(
+    "/blocks/striped_file_sink", &StripedFileSink::make);
@@ -0,0 +1,280 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "AsyncFileIO.hpp"
+#include "StripedFile.hpp"
+#include <Pothos/Framework.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif //_MSC_VER
+#include <cerrno>
+#include <cstring>
+#include <algorithm> //min
+#include <memory>
+#include <vector>
+#include <deque>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include <Poco/Logger.h>
+
+/***********************************************************************
+ * |PothosDoc Striped File Source
+ *
+ * Read a stream that was recorded across multiple files by the striped file sink,
+ * and write it to an output stream on port 0.
+ * The manifest of the recording lists the files and the stripe size.
+ * Reads are kept in flight on every file with asynchronous I/O,
+ * and the stripes are posted downstream in stream order without a copy.
+ *
+ * |category /Sources
+ * |category /File IO
+ * |keywords source binary file stripe raid
+ *
+ * |param dtype[Data Type] The output data type.
+ * |widget DTypeChooser(float=1,cfloat=1,int=1,cint=1,uint=1,cuint=1,dim=1)
+ * |default "complex_float64"
+ * |preview disable
+ *
+ * |param manifest[Manifest Path] The path to the JSON manifest file.
+ * |default ""
+ * |widget FileEntry(mode=open)
+ *
+ * |param rewind[Auto Rewind] Enable automatic rewind.
+ * When rewind is enabled, the source will stream from the beginning
+ * of the recording after the end is reached.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |param queueDepth[Queue Depth] The number of reads to keep in flight for each file.
+ * |default 4
+ * |preview valid
+ *
+ * |param directIO[Direct I/O] Bypass the page cache for the stripe files.
+ * |default false
+ * |option [Disabled] false
+ * |option [Enabled] true
+ * |preview valid
+ *
+ * |factory /blocks/striped_file_source(dtype)
+ * |setter setManifestPath(manifest)
+ * |setter setAutoRewind(rewind)
+ * |setter setQueueDepth(queueDepth)
+ * |setter setDirectIO(directIO)
+ **********************************************************************/
+class StripedFileSource : public Pothos::Block
+{
+public:
+    static Block *make(const Pothos::DType &dtype)
+    {
+        return new StripedFileSource(dtype);
+    }
+
+    StripedFileSource(const Pothos::DType &dtype):
+        _rewind(false),
+        _queueDepth(4),
+        _directIO(false),
+        _stripeIndex(0),
+        _nextTag(0),
+        _failed(false)
+    {
+        this->setupOutput(0, dtype);
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSource, setManifestPath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSource, setAutoRewind));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSource, setQueueDepth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(StripedFileSource, setDirectIO));
+    }
+
+    void setManifestPath(const std::string &path)
+    {
+        _manifestPath = path;
+    }
+
+    void setAutoRewind(const bool rewind)
+    {
+        _rewind = rewind;
+    }
+
+    void setQueueDepth(const size_t queueDepth)
+    {
+        if (queueDepth == 0) throw Pothos::InvalidArgumentException("StripedFileSource::setQueueDepth()", "queue depth cannot be zero");
+        _queueDepth = queueDepth;
+    }
+
+    void setDirectIO(const bool directIO)
+    {
+        _directIO = directIO;
+    }
+
+    void activate(void)
+    {
+        if (_manifestPath.empty()) throw Pothos::FileException("StripedFileSource", "empty manifest path");
+        _manifest = loadStripedManifest(_manifestPath);
+
+        //stripes are posted as buffers, so elements cannot span stripes
+        const auto &dtype = this->output(0)->dtype();
+        if (_manifest.stripeSize % dtype.size() != 0) throw Pothos::DataFormatException("StripedFileSource",
+            "stripe size is not a multiple of the element size");
+        if (Pothos::DType(_manifest.dtype, _manifest.dimension).size() != dtype.size())
+        {
+            poco_warning_f2(Poco::Logger::get("StripedFileSource"), "recorded data type %s does not match %s",
+                _manifest.dtype, dtype.toString());
+        }
+
+        //every stripe file is needed to reassemble the stream
+        for (const auto &path : _manifest.paths)
+        {
+            const int fd = openStripeFile(path, O_RDONLY | O_BINARY, _directIO);
+            if (fd < 0)
+            {
+                const std::string error(strerror(errno));
+                this->closeFiles();
+                throw Pothos::FileException("StripedFileSource::activate("+path+")", error);
+            }
+            _fds.push_back(fd);
+        }
+
+        _aio.reset(new AsyncFileIO(unsigned(_queueDepth*_fds.size())));
+        _stripeIndex = 0;
+        _failed = false;
+    }
+
+    void deactivate(void)
+    {
+        //reads in flight must complete before the buffers and files are released
+        _aio.reset();
+        _reads.clear();
+        _slots.clear();
+        this->closeFiles();
+    }
+
+    void work(void)
+    {
+        auto out0 = this->output(0);
+        const auto stripeSize = _manifest.stripeSize;
+        const auto numFiles = _fds.size();
+
+        //queue reads of the next stripes in stream order
+        while (_stripeIndex*stripeSize < _manifest.totalBytes and _reads.size() < _queueDepth*numFiles)
+        {
+            PendingRead read;
+            read.tag = _nextTag++;
+            read.slot = this->freeSlot();
+            read.length = size_t(std::min<unsigned long long>(stripeSize, _manifest.totalBytes - _stripeIndex*stripeSize));
+            _slots[read.slot].busy = true;
+            const int fd = _fds[size_t(_stripeIndex % numFiles)];
+            const unsigned long long offset = (_stripeIndex / numFiles)*stripeSize;
+            _aio->read(fd, reinterpret_cast<void *>(_slots[read.slot].buff.getAddress()), stripeSize, offset, read.tag);
+            _stripeIndex++;
+            _reads.push_back(read);
+        }
+
+        //wait for the oldest read, and collect other completions without waiting
+        bool wait = true;
+        unsigned long long tag = 0;
+        long result = 0;
+        while (not _reads.empty() and _aio->complete(tag, result, wait))
+        {
+            auto &read = _reads[size_t(tag - _reads.front().tag)];
+            read.done = true;
+            read.result = result;
+            wait = not _reads.front().done;
+        }
+
+        //post the completed stripes in stream order
+        const size_t elemSize = out0->dtype().size();
+        while (not _reads.empty() and _reads.front().done)
+        {
+            const auto read = _reads.front();
+            _reads.pop_front();
+            _slots[read.slot].busy = false;
+            //a failed read ends playback rather than leaving a hole in the stream
+            if (read.result < 0)
+            {
+                poco_error_f2(Poco::Logger::get("StripedFileSource"), "read() returned %d -- %s", int(read.result), std::string(strerror(int(-read.result))));
+                _aio->drain();
+                _reads.clear();
+                for (auto &slot : _slots) slot.busy = false;
+                _stripeIndex = (_manifest.totalBytes + stripeSize - 1)/stripeSize;
+                _failed = true;
+                break;
+            }
+
+            const size_t length = (std::min(size_t(read.result), read.length)/elemSize)*elemSize;
+            if (length == 0) continue;
+            Pothos::BufferChunk buff(_slots[read.slot].buff);
+            buff.length = length;
+            buff.dtype = out0->dtype();
+            out0->postBuffer(std::move(buff));
+        }
+
+        //start again from the beginning once all stripes were posted
+        if (_rewind and not _failed and _reads.empty() and _stripeIndex*stripeSize >= _manifest.totalBytes) _stripeIndex = 0;
+    }
+
+private:
+
+    void closeFiles(void)
+    {
+        for (const auto fd : _fds) close(fd);
+        _fds.clear();
+    }
+
+    //find a buffer that is not in flight and not held downstream, or allocate one
+    size_t freeSlot(void)
+    {
+        for (size_t i = 0; i < _slots.size(); i++)
+        {
+            if (not _slots[i].busy and _slots[i].buff.unique()) return i;
+        }
+
+        const auto container = AsyncFileIO::allocate(_manifest.stripeSize);
+        ReadSlot slot;
+        slot.buff = Pothos::SharedBuffer(size_t(container.get()), _manifest.stripeSize, container);
+        _slots.push_back(slot);
+        return _slots.size()-1;
+    }
+
+    struct ReadSlot
+    {
+        ReadSlot(void): busy(false){}
+        Pothos::SharedBuffer buff;
+        bool busy;
+    };
+
+    struct PendingRead
+    {
+        PendingRead(void): tag(0), slot(0), length(0), result(0), done(false){}
+        unsigned long long tag;
+        size_t slot;
+        size_t length;
+        long result;
+        bool done;
+    };
+
+    std::string _manifestPath;
+    bool _rewind;
+    size_t _queueDepth;
+    bool _directIO;
+    StripedManifest _manifest;
+    std::vector<int> _fds;
+    std::unique_ptr<AsyncFileIO> _aio;
+    std::vector<ReadSlot> _slots;
+    std::deque<PendingRead> _reads;
+    unsigned long long _stripeIndex;
+    unsigned long long _nextTag;
+    bool _failed;
+};
+
+static Pothos::BlockRegistry registerStripedFileSource(
+    "/blocks/striped_file_source", &StripedFileSource::make);
@@ -5,13 +5,21 @@
 #include <Pothos/Framework.hpp>
 #include <Pothos/Proxy.hpp>
 #include <Poco/TemporaryFile.h>
+#include <Poco/File.h>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include <cstdint>
 #include <json.hpp>
 
 using json = nlohmann::json;
 
-POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_blocks)
+static void test_binary_file_blocks(const bool memoryMap, const size_t queueDepth)
 {
+    std::cout << "testing binary file blocks, memory map " << memoryMap << ", queue depth " << queueDepth << std::endl;
     auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
     auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
 
@@ -21,9 +29,15 @@ POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_blocks)
 
     auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "int");
     fileSource.call("setFilePath", tempFile.path());
+    fileSource.call("setMemoryMap", memoryMap);
+    fileSource.call("setWindowSize", 1000); //multiple windows, not page aligned
+    fileSource.call("setQueueDepth", queueDepth);
+    fileSource.call("setBlockSize", 1000); //multiple blocks, rounded to the page size
 
     auto fileSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
     fileSink.call("setFilePath", tempFile.path());
+    fileSink.call("setQueueDepth", queueDepth);
+    fileSink.call("setBlockSize", 1000); //partial final block is truncated
 
     //create a test plan
     json testPlan;
@@ -52,3 +66,496 @@ POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_blocks)
 
     collector.call("verifyTestPlan", expected);
 }
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_blocks)
+{
+    test_binary_file_blocks(false, 0);
+    test_binary_file_blocks(false, 4);
+    #ifndef _MSC_VER
+    test_binary_file_blocks(true, 0);
+    #endif //_MSC_VER
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_sink_segments)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+
+    auto fileSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
+    fileSink.call("setFilePath", tempFile.path());
+    fileSink.call("setPreallocate", 4096);
+    fileSink.call("setSegmentSize", 3000);
+
+    auto b0 = Pothos::BufferChunk(10000);
+    feeder.call("feedBuffer", b0);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, fileSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //three full segments and the remainder, the unused next segment is removed
+    const size_t segmentIndex = fileSink.call("getSegmentIndex");
+    POTHOS_TEST_EQUAL(segmentIndex, 3);
+    const size_t expectedSizes[] = {3000, 3000, 3000, 1000};
+    for (size_t i = 0; i < 4; i++)
+    {
+        Poco::File segment(tempFile.path() + "_000" + std::to_string(i));
+        POTHOS_TEST_TRUE(segment.exists());
+        POTHOS_TEST_EQUAL(segment.getSize(), expectedSizes[i]);
+        segment.remove();
+    }
+    POTHOS_TEST_TRUE(not Poco::File(tempFile.path() + "_0004").exists());
+
+    //asynchronous writes roll over after whole blocks
+    auto asyncFile = Poco::TemporaryFile();
+    auto asyncSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
+    asyncSink.call("setFilePath", asyncFile.path());
+    asyncSink.call("setQueueDepth", 2);
+    asyncSink.call("setBlockSize", 4096);
+    asyncSink.call("setSegmentSize", 8192);
+
+    auto b1 = Pothos::BufferChunk(20000);
+    for (size_t i = 0; i < b1.length; i++) b1.as<char *>()[i] = char(i*7);
+    feeder.call("feedBuffer", b1);
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, asyncSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //two full segments and the remainder, with the stream split across them
+    const size_t asyncIndex = asyncSink.call("getSegmentIndex");
+    POTHOS_TEST_EQUAL(asyncIndex, 2);
+    std::string recorded;
+    for (size_t i = 0; i < 3; i++)
+    {
+        const auto path = asyncFile.path() + "_000" + std::to_string(i);
+        std::ifstream segment(path.c_str(), std::ios::binary);
+        recorded += std::string((std::istreambuf_iterator<char>(segment)), std::istreambuf_iterator<char>());
+        Poco::File(path).remove();
+    }
+    POTHOS_TEST_EQUAL(recorded.size(), b1.length);
+    POTHOS_TEST_TRUE(recorded == std::string(b1.as<const char *>(), b1.length));
+    POTHOS_TEST_TRUE(not Poco::File(asyncFile.path() + "_0003").exists());
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_sink_segment_time)
+{
+    //a file source plays back 2000 bytes in 0.2 seconds
+    auto inputFile = Poco::TemporaryFile();
+    std::string ramp(2000, '\0');
+    for (size_t i = 0; i < ramp.size(); i++) ramp[i] = char(i*7);
+    std::ofstream(inputFile.path().c_str(), std::ios::binary).write(ramp.data(), ramp.size());
+
+    //rolling by time from the start, and rolling enabled while recording
+    for (size_t t = 0; t < 2; t++)
+    {
+        std::cout << "testing segment time, enabled while active " << t << std::endl;
+        auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "uint8");
+        fileSource.call("setFilePath", inputFile.path());
+        fileSource.call("setSampleRate", 10000.0);
+        fileSource.call("setPacing", true);
+
+        auto tempFile = Poco::TemporaryFile();
+        auto fileSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
+        fileSink.call("setFilePath", tempFile.path());
+        if (t == 0) fileSink.call("setSegmentTime", 0.05);
+        {
+            Pothos::Topology topology;
+            topology.connect(fileSource, 0, fileSink, 0);
+            topology.commit();
+            if (t == 1) fileSink.call("setSegmentTime", 0.05);
+            POTHOS_TEST_TRUE(topology.waitInactive());
+        }
+
+        //the first file keeps the plain path when rolling was enabled later
+        const size_t segmentIndex = fileSink.call("getSegmentIndex");
+        POTHOS_TEST_TRUE(segmentIndex >= 2);
+        POTHOS_TEST_TRUE(segmentIndex < 10);
+        std::string recorded;
+        for (size_t i = 0; i <= segmentIndex; i++)
+        {
+            const auto path = (t == 1 and i == 0)? tempFile.path() : tempFile.path() + "_000" + std::to_string(i);
+            std::ifstream segment(path.c_str(), std::ios::binary);
+            recorded += std::string((std::istreambuf_iterator<char>(segment)), std::istreambuf_iterator<char>());
+            Poco::File(path).remove();
+        }
+        POTHOS_TEST_EQUAL(recorded.size(), ramp.size());
+        POTHOS_TEST_TRUE(recorded == ramp);
+        POTHOS_TEST_TRUE(not Poco::File(tempFile.path() + "_000" + std::to_string(segmentIndex+1)).exists());
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_metadata)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+    Poco::TemporaryFile::registerForDeletion(tempFile.path() + ".meta");
+
+    auto fileSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
+    fileSink.call("setFilePath", tempFile.path());
+    fileSink.call("setMetadata", true);
+
+    auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "int");
+    fileSource.call("setFilePath", tempFile.path());
+    fileSource.call("setMetadata", true);
+
+    //feed a message, a buffer, and labels within the buffer
+    feeder.call("feedMessage", Pothos::Object("msg0"));
+    auto b0 = Pothos::BufferChunk(100*sizeof(int));
+    int *p0 = b0;
+    for (size_t i = 0; i < 100; i++) p0[i] = i;
+    feeder.call("feedBuffer", b0);
+    feeder.call("feedLabel", Pothos::Label("id0", "lbl0", 10));
+    feeder.call("feedLabel", Pothos::Label("id1", "lbl1", 50));
+
+    //record to file
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, fileSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //replay from file
+    {
+        Pothos::Topology topology;
+        topology.connect(fileSource, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    std::vector<Pothos::Object> msgs = collector.call("getMessages");
+    std::vector<Pothos::Label> lbls = collector.call("getLabels");
+    Pothos::BufferChunk buff = collector.call("getBuffer");
+
+    POTHOS_TEST_EQUAL(buff.length, 100*sizeof(int));
+    POTHOS_TEST_EQUAL(msgs.size(), 1);
+    POTHOS_TEST_EQUAL(msgs[0].extract<std::string>(), "msg0");
+    POTHOS_TEST_EQUAL(lbls.size(), 2);
+    POTHOS_TEST_EQUAL(lbls[0].id, "id0");
+    POTHOS_TEST_EQUAL(lbls[1].id, "id1");
+    POTHOS_TEST_EQUAL(lbls[0].index, 10);
+    POTHOS_TEST_EQUAL(lbls[1].index, 50);
+    POTHOS_TEST_EQUAL(lbls[0].data.extract<std::string>(), "lbl0");
+    POTHOS_TEST_EQUAL(lbls[1].data.extract<std::string>(), "lbl1");
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_source_seek)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+
+    auto fileSink = Pothos::BlockRegistry::make("/blocks/binary_file_sink");
+    fileSink.call("setFilePath", tempFile.path());
+
+    //record a ramp of 10000 elements
+    auto b0 = Pothos::BufferChunk(10000*sizeof(int));
+    int *p0 = b0;
+    for (size_t i = 0; i < 10000; i++) p0[i] = i;
+    feeder.call("feedBuffer", b0);
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, fileSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //play back windows and seek positions with synchronous and asynchronous reads
+    for (size_t queueDepth = 0; queueDepth <= 2; queueDepth += 2)
+    {
+        std::cout << "testing seek, queue depth " << queueDepth << std::endl;
+        const size_t begins[] = {2500, 9000, 5000};
+        const size_t ends[] = {7500, 10000, 10000};
+        for (size_t t = 0; t < 3; t++)
+        {
+            auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+            auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "int");
+            fileSource.call("setFilePath", tempFile.path());
+            fileSource.call("setQueueDepth", queueDepth);
+            fileSource.call("setBlockSize", 4096);
+            if (t == 0)
+            {
+                fileSource.call("setStartOffset", begins[t]);
+                fileSource.call("setLength", ends[t]-begins[t]);
+            }
+            else if (t == 1) fileSource.call("seek", begins[t]);
+            else
+            {
+                fileSource.call("setSampleRate", 1000.0);
+                fileSource.call("seekTime", 5.0);
+            }
+
+            {
+                Pothos::Topology topology;
+                topology.connect(fileSource, 0, collector, 0);
+                topology.commit();
+                POTHOS_TEST_TRUE(topology.waitInactive());
+            }
+
+            const unsigned long long position = fileSource.call("getPosition");
+            POTHOS_TEST_EQUAL(position, ends[t]);
+            Pothos::BufferChunk buff = collector.call("getBuffer");
+            POTHOS_TEST_EQUAL(buff.elements(), ends[t]-begins[t]);
+            const int *pb = buff;
+            for (size_t i = 0; i < buff.elements(); i++) POTHOS_TEST_EQUAL(pb[i], int(begins[t]+i));
+        }
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_source_pacing)
+{
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+    std::vector<int> ramp(5000);
+    for (size_t i = 0; i < ramp.size(); i++) ramp[i] = int(i);
+    std::ofstream(tempFile.path().c_str(), std::ios::binary).write(reinterpret_cast<const char *>(ramp.data()), ramp.size()*sizeof(int));
+
+    //5000 elements at 20000 elements per second take 0.25 seconds
+    for (size_t queueDepth = 0; queueDepth <= 2; queueDepth += 2)
+    {
+        std::cout << "testing pacing, queue depth " << queueDepth << std::endl;
+        auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+        auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "int");
+        fileSource.call("setFilePath", tempFile.path());
+        fileSource.call("setQueueDepth", queueDepth);
+        fileSource.call("setSampleRate", 20000.0);
+        fileSource.call("setPacing", true);
+
+        const auto start = std::chrono::steady_clock::now();
+        {
+            Pothos::Topology topology;
+            topology.connect(fileSource, 0, collector, 0);
+            topology.commit();
+            POTHOS_TEST_TRUE(topology.waitInactive(0.01, 2.0));
+        }
+        const std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+        std::cout << "elapsed " << elapsed.count() << " seconds" << std::endl;
+
+        //the last element is not released early, waitInactive() bounds a stalled source
+        POTHOS_TEST_TRUE(elapsed.count() >= 0.249);
+
+        Pothos::BufferChunk buff = collector.call("getBuffer");
+        POTHOS_TEST_EQUAL(buff.elements(), ramp.size());
+        POTHOS_TEST_EQUALA(buff.as<const int *>(), ramp.data(), ramp.size());
+        const std::vector<Pothos::Label> labels = collector.call("getLabels");
+        POTHOS_TEST_TRUE(not labels.empty());
+        POTHOS_TEST_EQUAL(labels[0].id, "rxRate");
+        POTHOS_TEST_EQUAL(labels[0].index, 0);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_binary_file_source_read_error)
+{
+    //reading a directory fails, so every asynchronous read returns an error
+    auto tempDir = Poco::TemporaryFile();
+    std::cout << "tempDir " << tempDir.path() << std::endl;
+    POTHOS_TEST_TRUE(tempDir.createDirectory());
+
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto fileSource = Pothos::BlockRegistry::make("/blocks/binary_file_source", "int");
+    fileSource.call("setFilePath", tempDir.path());
+    fileSource.call("setQueueDepth", 4);
+    fileSource.call("setBlockSize", 4096);
+
+    //the failed read ends playback, the reads queued after it are discarded
+    {
+        Pothos::Topology topology;
+        topology.connect(fileSource, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const unsigned long long position = fileSource.call("getPosition");
+    POTHOS_TEST_EQUAL(position, 0);
+    Pothos::BufferChunk buff = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buff.length, 0);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_striped_file_blocks)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+
+    auto manifestFile = Poco::TemporaryFile();
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < 3; i++)
+    {
+        paths.push_back(manifestFile.path() + "_stripe" + std::to_string(i));
+        Poco::TemporaryFile::registerForDeletion(paths.back());
+    }
+
+    auto fileSink = Pothos::BlockRegistry::make("/blocks/striped_file_sink");
+    fileSink.call("setManifestPath", manifestFile.path());
+    fileSink.call("setFilePaths", paths);
+    fileSink.call("setStripeSize", 4096);
+    fileSink.call("setQueueDepth", 2);
+
+    auto fileSource = Pothos::BlockRegistry::make("/blocks/striped_file_source", "int");
+    fileSource.call("setManifestPath", manifestFile.path());
+    fileSource.call("setQueueDepth", 2);
+
+    //enough data for several rounds of stripes over the files
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["minTrials"] = 100;
+    testPlan["maxTrials"] = 200;
+    testPlan["minSize"] = 512;
+    testPlan["maxSize"] = 2048;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, fileSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    {
+        Pothos::Topology topology;
+        topology.connect(fileSource, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    collector.call("verifyTestPlan", expected);
+
+    //the stream cannot be reassembled without every stripe file
+    Poco::File(paths[1]).remove();
+    {
+        Pothos::Topology topology;
+        topology.connect(fileSource, 0, collector, 0);
+        POTHOS_TEST_THROWS(topology.commit(), Pothos::Exception);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_flight_recorder)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+
+    //one second before and two seconds after the trigger
+    auto recorder = Pothos::BlockRegistry::make("/blocks/flight_recorder", "int");
+    recorder.call("setFilePath", tempFile.path());
+    recorder.call("setSampleRate", 1000.0);
+    recorder.call("setPreTrigger", 1.0);
+    recorder.call("setPostTrigger", 2.0);
+    recorder.call("setLabelTrigger", "T");
+
+    //a ramp in several buffers, the second trigger is within the post-trigger window
+    for (size_t b = 0; b < 10; b++)
+    {
+        auto buff = Pothos::BufferChunk(1000*sizeof(int));
+        int *p = buff;
+        for (size_t i = 0; i < 1000; i++) p[i] = int(b*1000 + i);
+        feeder.call("feedBuffer", buff);
+    }
+    feeder.call("feedLabel", Pothos::Label("T", Pothos::Object(), 5500));
+    feeder.call("feedLabel", Pothos::Label("T", Pothos::Object(), 6000));
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, recorder, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const unsigned long long captureCount = recorder.call("getCaptureCount");
+    POTHOS_TEST_EQUAL(captureCount, 1);
+    const auto capturePath = tempFile.path() + "_0000";
+    Poco::File capture(capturePath);
+    POTHOS_TEST_TRUE(capture.exists());
+    POTHOS_TEST_EQUAL(capture.getSize(), 3000*sizeof(int));
+
+    std::vector<int> data(3000);
+    std::ifstream file(capturePath.c_str(), std::ios::binary);
+    file.read(reinterpret_cast<char *>(data.data()), data.size()*sizeof(int));
+    for (size_t i = 0; i < data.size(); i++) POTHOS_TEST_EQUAL(data[i], int(4500 + i));
+    file.close();
+    capture.remove();
+}
+
+/***********************************************************************
+ * Text file sink: write one buffer or one message and read back the text
+ **********************************************************************/
+template <typename Type>
+static Pothos::BufferChunk makeBuffer(const Pothos::DType &dtype, const std::vector<Type> &values)
+{
+    Pothos::BufferChunk buff(dtype, values.size()*sizeof(Type)/dtype.size());
+    std::memcpy(buff.as<void *>(), values.data(), buff.length);
+    return buff;
+}
+
+static std::string writeTextFile(const std::string &format, const Pothos::BufferChunk &buff, const Pothos::Object &msg = Pothos::Object())
+{
+    auto tempFile = Poco::TemporaryFile();
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", buff? buff.dtype : Pothos::DType("uint8"));
+    auto textSink = Pothos::BlockRegistry::make("/blocks/text_file_sink");
+    textSink.call("setFilePath", tempFile.path());
+    textSink.call("setFormat", format);
+    if (buff) feeder.call("feedBuffer", buff);
+    if (msg) feeder.call("feedMessage", msg);
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, textSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    std::ifstream file(tempFile.path().c_str(), std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_text_file_sink)
+{
+    const auto int8s = makeBuffer(Pothos::DType("int8"), std::vector<int8_t>{0, 127, -128, -1});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", int8s), "0\n127\n-128\n-1\n");
+    POTHOS_TEST_EQUAL(writeTextFile("TSV", int8s), "0\n127\n-128\n-1\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", int8s), "00\n7f\n80\nff\n");
+
+    const auto int64s = makeBuffer(Pothos::DType("int64"), std::vector<int64_t>{
+        std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), -1});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", int64s), "-9223372036854775808\n9223372036854775807\n-1\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", int64s), "8000000000000000\n7fffffffffffffff\nffffffffffffffff\n");
+
+    const auto uint64s = makeBuffer(Pothos::DType("uint64"), std::vector<uint64_t>{0, 1, std::numeric_limits<uint64_t>::max()});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", uint64s), "0\n1\n18446744073709551615\n");
+    POTHOS_TEST_EQUAL(writeTextFile("TSV", uint64s), "0\n1\n18446744073709551615\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", uint64s), "0000000000000000\n0000000000000001\nffffffffffffffff\n");
+
+    //floats use the default precision of 6 digits, hex writes the bits
+    const auto float32s = makeBuffer(Pothos::DType("float32"), std::vector<float>{1.5f, -0.25f, 1e10f, 0.1f});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", float32s), "1.5\n-0.25\n1e+10\n0.1\n");
+    POTHOS_TEST_EQUAL(writeTextFile("TSV", float32s), "1.5\n-0.25\n1e+10\n0.1\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", float32s), "3fc00000\nbe800000\n501502f9\n3dcccccd\n");
+
+    const auto complexes = makeBuffer(Pothos::DType("complex_float32"), std::vector<float>{1.0f, -2.0f, 0.5f, 3.0f});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", complexes), "(1,-2)\n(0.5,3)\n");
+    POTHOS_TEST_EQUAL(writeTextFile("TSV", complexes), "(1,-2)\n(0.5,3)\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", complexes), "3f800000 c0000000\n3f000000 40400000\n");
+
+    //the numbers of a vector element share a line
+    const auto vectors = makeBuffer(Pothos::DType("int32", 2), std::vector<int32_t>{1, -2, 3, 4});
+    POTHOS_TEST_EQUAL(writeTextFile("CSV", vectors), "1, -2\n3, 4\n");
+    POTHOS_TEST_EQUAL(writeTextFile("TSV", vectors), "1\t-2\n3\t4\n");
+    POTHOS_TEST_EQUAL(writeTextFile("HEX", vectors), "00000001 fffffffe\n00000003 00000004\n");
+
+    //messages are written as strings in every format
+    const Pothos::Object msg(std::string("hello"));
+    for (const std::string format : {"CSV", "TSV", "HEX"})
+    {
+        POTHOS_TEST_EQUAL(writeTextFile(format, Pothos::BufferChunk(), msg), msg.toString() + "\n");
+    }
+}
@@ -5,7 +5,10 @@
 #include <Poco/Logger.h>
 #include <complex>
 #include <fstream>
+#include <vector>
 #include <cerrno>
+#include <cstdio> //snprintf
+#include <cstring>
 
 /***********************************************************************
  * |PothosDoc Text File Sink
@@ -13,15 +16,20 @@
  * The text file sink reads input data from port 0 and writes it
  * into the output file in a delimited ascii string format.
  *
- * Note that this is not a high-performance block:
- * Conversion to string is not a fast operation
- * and it bloats the original size of the data many-fold.
+ * Note that conversion to text bloats the original size of the data many-fold.
+ * The formatting is done directly from the input data type
+ * into a large output buffer, which is written to the file when it fills up
+ * and when the block is deactivated.
  *
  * <h2>Stream input</h2>
  *
- * Streaming input buffers are converted to string with iostream formatting.
  * Each input element is output on its own line within the output file.
- * If an element is a vector of numbers, its elements will be comma-separated.
+ * Integers are written in decimal, floating point numbers are written
+ * like printf's %g format with the configured precision,
+ * and complex numbers are written as (real,imag).
+ * If an element is a vector of numbers, its elements will be separated
+ * by a comma in the CSV format or by a tab in the TSV format.
+ * The HEX format writes the bits of each number in hexadecimal, separated by spaces.
  * Labels are currently ignored by this implementation.
  *
  * <h2>Message input</h2>
@@ -45,8 +53,21 @@
  * |default ""
  * |widget FileEntry(mode=save)
  *
+ * |param format[Format] The text format for stream elements.
+ * |default "CSV"
+ * |option [Comma separated] "CSV"
+ * |option [Tab separated] "TSV"
+ * |option [Hexadecimal] "HEX"
+ * |preview valid
+ *
+ * |param precision[Precision] The number of significant digits for floating point numbers.
+ * |default 6
+ * |preview valid
+ *
  * |factory /blocks/text_file_sink()
  * |setter setFilePath(path)
+ * |setter setFormat(format)
+ * |setter setPrecision(precision)
  **********************************************************************/
 class TextFileSink : public Pothos::Block
 {
@@ -56,10 +77,16 @@ public:
         return new TextFileSink();
     }
 
-    TextFileSink(void)
+    TextFileSink(void):
+        _format(FORMAT_CSV),
+        _precision(6),
+        _out(OUTPUT_BUFFER_SIZE),
+        _outLength(0)
     {
         this->setupInput(0);
         this->registerCall(this, POTHOS_FCN_TUPLE(TextFileSink, setFilePath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(TextFileSink, setFormat));
+        this->registerCall(this, POTHOS_FCN_TUPLE(TextFileSink, setPrecision));
     }
 
     void setFilePath(const std::string &path)
@@ -73,6 +100,20 @@ public:
         }
     }
 
+    void setFormat(const std::string &format)
+    {
+        if (format == "CSV") _format = FORMAT_CSV;
+        else if (format == "TSV") _format = FORMAT_TSV;
+        else if (format == "HEX") _format = FORMAT_HEX;
+        else throw Pothos::InvalidArgumentException("TextFileSink::setFormat("+format+")", "unknown format");
+    }
+
+    void setPrecision(const int precision)
+    {
+        if (precision < 1 or precision > 17) throw Pothos::RangeException("TextFileSink::setPrecision("+std::to_string(precision)+")", "precision must be between 1 and 17");
+        _precision = precision;
+    }
+
     void activate(void)
     {
         if (_path.empty()) throw Pothos::FileException("TextFileSink", "empty file path");
@@ -85,6 +126,7 @@ public:
 
     void deactivate(void)
     {
+        this->flush();
         _file.close();
     }
 
@@ -116,44 +158,167 @@ public:
 
 private:
 
+    enum Format
+    {
+        FORMAT_CSV,
+        FORMAT_TSV,
+        FORMAT_HEX
+    };
+
+    //the output buffer is written to the file when it fills up
+    static const size_t OUTPUT_BUFFER_SIZE = 1024*1024;
+
+    //the longest formatted number: sign, 17 digits, point, and exponent
+    static const size_t MAX_NUMBER_CHARS = 32;
+
+    void flush(void)
+    {
+        if (_outLength != 0 and _file.good()) _file.write(_out.data(), _outLength);
+        _outLength = 0;
+    }
+
+    //make room for the given number of characters in the output buffer
+    char *reserve(const size_t length)
+    {
+        if (_outLength + length > _out.size()) this->flush();
+        if (length > _out.size()) _out.resize(length);
+        return _out.data() + _outLength;
+    }
+
     void writeObject(const Pothos::Object &obj)
     {
         if (not _file.good()) return;
-        _file << obj.toString() << std::endl;
+        const auto str = obj.toString();
+        char *p = this->reserve(str.size()+1);
+        std::memcpy(p, str.data(), str.size());
+        p[str.size()] = '\n';
+        _outLength += str.size()+1;
     }
 
     void writeBuffer(const Pothos::BufferChunk &buff)
     {
         if (not _file.good()) return;
 
-        //all complex types, even complex integers are converted to complex doubles and written out
-        if (buff.dtype.isComplex()) this->writeBuffer<std::complex<double>>(buff);
-
-        //then convert all floating point types to doubles to write them out
-        else if (buff.dtype.isFloat()) this->writeBuffer<double>(buff);
+        //select the formatter for the scalar type, complex numbers have two scalars
+        const auto &dtype = buff.dtype;
+        const size_t scalarSize = dtype.isComplex()? dtype.elemSize()/2 : dtype.elemSize();
+        if (_format == FORMAT_HEX) switch (scalarSize)
+        {
+        case 1: return this->writeElements<uint8_t>(buff);
+        case 2: return this->writeElements<uint16_t>(buff);
+        case 4: return this->writeElements<uint32_t>(buff);
+        case 8: return this->writeElements<uint64_t>(buff);
+        }
+        else if (dtype.isFloat()) switch (scalarSize)
+        {
+        case 4: return this->writeElements<float>(buff);
+        case 8: return this->writeElements<double>(buff);
+        }
+        else if (dtype.isInteger() and dtype.isSigned()) switch (scalarSize)
+        {
+        case 1: return this->writeElements<int8_t>(buff);
+        case 2: return this->writeElements<int16_t>(buff);
+        case 4: return this->writeElements<int32_t>(buff);
+        case 8: return this->writeElements<int64_t>(buff);
+        }
+        else switch (scalarSize)
+        {
+        case 1: return this->writeElements<uint8_t>(buff);
+        case 2: return this->writeElements<uint16_t>(buff);
+        case 4: return this->writeElements<uint32_t>(buff);
+        case 8: return this->writeElements<uint64_t>(buff);
+        }
 
-        //the remaining integer types are converted to long long to write out
-        else this->writeBuffer<long long>(buff);
+        //other types are written byte by byte
+        this->writeElements<uint8_t>(buff);
     }
 
     template <typename Type>
-    void writeBuffer(const Pothos::BufferChunk &buff)
+    void writeElements(const Pothos::BufferChunk &buff)
     {
-        const auto outBuff = buff.convert(typeid(Type), buff.dtype.dimension());
-        const Type *elems = outBuff;
+        const bool isComplex = buff.dtype.isComplex() and _format != FORMAT_HEX;
+        const char sep = (_format == FORMAT_CSV)? ',' : ((_format == FORMAT_TSV)? '\t' : ' ');
+        const size_t scalarsPerNumber = isComplex? 2 : 1;
+        const size_t numbersPerLine = buff.length/sizeof(Type)/scalarsPerNumber/std::max<size_t>(1, buff.elements());
+        const Type *in = buff.as<const Type *>();
+
         for (size_t i = 0; i < buff.elements(); i++)
         {
-            for (size_t j = 0; j < buff.dtype.dimension(); j++)
+            char *p = this->reserve(numbersPerLine*scalarsPerNumber*(MAX_NUMBER_CHARS+4));
+            const char *begin = p;
+            for (size_t j = 0; j < numbersPerLine; j++)
             {
-                _file << (*(elems++));
-                if (j+1 == buff.dtype.dimension()) _file << std::endl;
-                else _file << ", ";
+                if (j != 0)
+                {
+                    *p++ = sep;
+                    if (_format == FORMAT_CSV) *p++ = ' ';
+                }
+                if (not isComplex) p = this->format(p, *in++);
+                else
+                {
+                    *p++ = '(';
+                    p = this->format(p, *in++);
+                    *p++ = ',';
+                    p = this->format(p, *in++);
+                    *p++ = ')';
+                }
             }
+            *p++ = '\n';
+            _outLength += size_t(p - begin);
         }
     }
 
+    static char *formatUnsigned(char *p, unsigned long long x)
+    {
+        char digits[20];
+        size_t n = 0;
+        do digits[n++] = char('0' + x%10);
+        while ((x /= 10) != 0);
+        while (n != 0) *p++ = digits[--n];
+        return p;
+    }
+
+    static char *formatSigned(char *p, const long long x)
+    {
+        if (x >= 0) return formatUnsigned(p, (unsigned long long)(x));
+        *p++ = '-';
+        return formatUnsigned(p, 0ULL - (unsigned long long)(x));
+    }
+
+    template <typename UType>
+    static char *formatHex(char *p, const UType x)
+    {
+        static const char hex[] = "0123456789abcdef";
+        for (int shift = int(sizeof(UType)*8)-4; shift >= 0; shift -= 4) *p++ = hex[(x >> shift) & 0xf];
+        return p;
+    }
+
+    char *formatFloat(char *p, const double x) const
+    {
+        return p + std::snprintf(p, MAX_NUMBER_CHARS, "%.*g", _precision, x);
+    }
+
+    char *format(char *p, const int8_t x) const {return formatSigned(p, x);}
+    char *format(char *p, const int16_t x) const {return formatSigned(p, x);}
+    char *format(char *p, const int32_t x) const {return formatSigned(p, x);}
+    char *format(char *p, const int64_t x) const {return formatSigned(p, x);}
+    char *format(char *p, const float x) const {return this->formatFloat(p, x);}
+    char *format(char *p, const double x) const {return this->formatFloat(p, x);}
+
+    //unsigned types are also used for the bits of any type in the hex format
+    template <typename UType>
+    char *format(char *p, const UType x) const
+    {
+        if (_format == FORMAT_HEX) return formatHex(p, x);
+        return formatUnsigned(p, x);
+    }
+
     std::ofstream _file;
     std::string _path;
+    Format _format;
+    int _precision;
+    std::vector<char> _out;
+    size_t _outLength;
 };
 
 static Pothos::BlockRegistry registerTextFileSink(
@@ -0,0 +1,267 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Framework.hpp>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************************
+ * |PothosDoc Packet Demux
+ *
+ * The packet demux block routes packet messages from input port 0
+ * to one of several output ports based on a key found in each packet.
+ * The key can be read from a packet metadata entry, from the data
+ * of a packet label, or directly from the bytes of the packet payload.
+ *
+ * This is zero-copy block implementation.
+ * Packets are forwarded as-is to the selected output port.
+ * All messages enqueued on the input port are handled per call to work().
+ *
+ * <h2>Routing</h2>
+ *
+ * Each key value is mapped to an output port index with the route table.
+ * Small key values are resolved with a direct lookup table,
+ * and larger key values are resolved with a hash table.
+ * Packets with no key or an unmapped key are sent to the default port.
+ * Non-packet messages are always sent to the default port.
+ * A default port of -1 indicates that such packets will be dropped.
+ *
+ * |category /Packet
+ * |keywords packet message demux router switch
+ *
+ * |param numOutputs[Num Outputs] The number of output ports.
+ * |default 2
+ * |widget SpinBox(minimum=1)
+ * |preview disable
+ *
+ * |param keySource[Key Source] Where to find the routing key in each packet.
+ * <ul>
+ * <li>"METADATA" - the key is the value of the metadata entry named by key name</li>
+ * <li>"LABEL" - the key is the data of the first label with the ID key name</li>
+ * <li>"PAYLOAD" - the key is an unsigned big endian integer in the payload bytes</li>
+ * </ul>
+ * |default "METADATA"
+ * |option [Metadata] "METADATA"
+ * |option [Label] "LABEL"
+ * |option [Payload] "PAYLOAD"
+ *
+ * |param keyName[Key Name] The metadata key or label ID that holds the routing key.
+ * Unused in the payload key source mode.
+ * |default "sid"
+ * |widget StringEntry()
+ * |preview valid
+ *
+ * |param keyOffset[Key Offset] The offset of the key in the payload in bytes.
+ * Only used in the payload key source mode.
+ * |default 0
+ * |units bytes
+ * |preview valid
+ *
+ * |param keyWidth[Key Width] The width of the key in the payload in bytes.
+ * Only used in the payload key source mode.
+ * |default 1
+ * |option 1
+ * |option 2
+ * |option 4
+ * |option 8
+ * |units bytes
+ * |preview valid
+ *
+ * |param routes An array of output port indexes indexed by key value.
+ * Routes is an array of integers where element N specifies the output port for key N.
+ * An output port of -1 indicates that the key will go to the default port.
+ * Keys that do not fit in an array can be mapped with the setRoute() call.
+ * <ul>
+ * <li>Example: [0, 1, 1] -> key 0 routes to output0, keys 1 and 2 route to output1</li>
+ * </ul>
+ * |default [0, 1]
+ *
+ * |param defaultPort[Default Port] The output port for packets without a mapped key.
+ * A default port of -1 indicates that such packets will be dropped.
+ * |default -1
+ * |preview valid
+ *
+ * |factory /blocks/packet_demux()
+ * |initializer setNumOutputs(numOutputs)
+ * |setter setKeySource(keySource)
+ * |setter setKeyName(keyName)
+ * |setter setKeyOffset(keyOffset)
+ * |setter setKeyWidth(keyWidth)
+ * |setter setRoutes(routes)
+ * |setter setDefaultPort(defaultPort)
+ **********************************************************************/
+class PacketDemux : public Pothos::Block
+{
+public:
+    static Block *make(void)
+    {
+        return new PacketDemux();
+    }
+
+    PacketDemux(void):
+        _keySource(KEY_METADATA),
+        _keyName("sid"),
+        _keyOffset(0),
+        _keyWidth(1),
+        _defaultPort(-1)
+    {
+        this->setupInput(0);
+        this->setupOutput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setNumOutputs));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setKeySource));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setKeyName));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setKeyOffset));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setKeyWidth));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setRoutes));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setRoute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, getRoute));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, setDefaultPort));
+        this->registerCall(this, POTHOS_FCN_TUPLE(PacketDemux, getDefaultPort));
+    }
+
+    void setNumOutputs(const size_t numOutputs)
+    {
+        for (size_t i = this->outputs().size(); i < numOutputs; i++) this->setupOutput(i);
+    }
+
+    void setKeySource(const std::string &keySource)
+    {
+        if (keySource == "METADATA") _keySource = KEY_METADATA;
+        else if (keySource == "LABEL") _keySource = KEY_LABEL;
+        else if (keySource == "PAYLOAD") _keySource = KEY_PAYLOAD;
+        else throw Pothos::InvalidArgumentException("PacketDemux::setKeySource("+keySource+")", "unknown key source");
+    }
+
+    void setKeyName(const std::string &keyName)
+    {
+        _keyName = keyName;
+    }
+
+    void setKeyOffset(const size_t keyOffset)
+    {
+        _keyOffset = keyOffset;
+    }
+
+    void setKeyWidth(const size_t keyWidth)
+    {
+        if (keyWidth == 0 or keyWidth > 8) throw Pothos::InvalidArgumentException(
+            "PacketDemux::setKeyWidth("+std::to_string(keyWidth)+")", "key width must be 1 to 8 bytes");
+        _keyWidth = keyWidth;
+    }
+
+    void setRoutes(const std::vector<int> &routes)
+    {
+        _table = routes;
+        _hashTable.clear();
+    }
+
+    void setRoute(const unsigned long long key, const int port)
+    {
+        if (key < _table.size()) _table[size_t(key)] = port;
+        else if (key < MAX_TABLE_SIZE)
+        {
+            _table.resize(size_t(key)+1, -1);
+            _table[size_t(key)] = port;
+        }
+        else _hashTable[key] = port;
+    }
+
+    int getRoute(const unsigned long long key) const
+    {
+        if (key < _table.size()) return _table[size_t(key)];
+        const auto it = _hashTable.find(key);
+        return (it == _hashTable.end())? -1 : it->second;
+    }
+
+    void setDefaultPort(const int port)
+    {
+        _defaultPort = port;
+    }
+
+    int getDefaultPort(void) const
+    {
+        return _defaultPort;
+    }
+
+    void work(void)
+    {
+        auto inputPort = this->input(0);
+
+        while (inputPort->hasMessage())
+        {
+            auto msg = inputPort->popMessage();
+
+            int dest = -1;
+            unsigned long long key = 0;
+            if (msg.type() == typeid(Pothos::Packet) and
+                this->extractKey(msg.extract<Pothos::Packet>(), key))
+            {
+                dest = this->getRoute(key);
+            }
+            if (dest < 0) dest = _defaultPort;
+
+            //drop when there is no destination for this packet
+            if (dest < 0 or size_t(dest) >= this->outputs().size()) continue;
+            this->output(dest)->postMessage(std::move(msg));
+        }
+    }
+
+private:
+
+    bool extractKey(const Pothos::Packet &packet, unsigned long long &key) const
+    {
+        switch (_keySource)
+        {
+        case KEY_METADATA:
+        {
+            const auto it = packet.metadata.find(_keyName);
+            if (it == packet.metadata.end()) return false;
+            if (not it->second.canConvert(typeid(unsigned long long))) return false;
+            key = it->second.convert<unsigned long long>();
+            return true;
+        }
+
+        case KEY_LABEL:
+            for (const auto &label : packet.labels)
+            {
+                if (label.id != _keyName) continue;
+                if (not label.data.canConvert(typeid(unsigned long long))) return false;
+                key = label.data.convert<unsigned long long>();
+                return true;
+            }
+            return false;
+
+        case KEY_PAYLOAD:
+        {
+            const auto &payload = packet.payload;
+            if (_keyOffset + _keyWidth > payload.length) return false;
+            const auto *p = payload.as<const unsigned char *>() + _keyOffset;
+            key = 0;
+            for (size_t i = 0; i < _keyWidth; i++) key = (key << 8) | p[i];
+            return true;
+        }
+        }
+        return false;
+    }
+
+    //keys below this limit are stored in the direct lookup table
+    static const unsigned long long MAX_TABLE_SIZE = 4096;
+
+    enum KeySource
+    {
+        KEY_METADATA,
+        KEY_LABEL,
+        KEY_PAYLOAD,
+    };
+
+    KeySource _keySource;
+    std::string _keyName;
+    size_t _keyOffset;
+    size_t _keyWidth;
+    int _defaultPort;
+    std::vector<int> _table;
+    std::unordered_map<unsigned long long, int> _hashTable;
+};
+
+static Pothos::BlockRegistry registerPacketDemux(
+    "/blocks/packet_demux", &PacketDemux::make);
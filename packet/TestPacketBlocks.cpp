@@ -5,6 +5,7 @@
 #include <Pothos/Framework.hpp>
 #include <Pothos/Proxy.hpp>
 #include <iostream>
+#include <vector>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -127,3 +128,171 @@ POTHOS_TEST_BLOCK("/blocks/tests", test_stream_to_packet)
     POTHOS_TEST_EQUAL(packet.payload.elements(), eofIndex-sofIndex+1);
     POTHOS_TEST_EQUALA(b0.as<const int *>()+sofIndex, packet.payload.as<const int *>(), packet.payload.elements());
 }
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_packet_demux)
+{
+    //create the blocks
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector0 = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto collector1 = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto collector2 = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto demux = Pothos::BlockRegistry::make("/blocks/packet_demux");
+    demux.call("setNumOutputs", 3);
+    demux.call("setKeySource", "PAYLOAD");
+    demux.call("setKeyOffset", 2);
+    demux.call("setKeyWidth", 2);
+    demux.call("setRoutes", std::vector<int>{0, 1});
+    demux.call("setRoute", 0x1234, 1);
+    demux.call("setDefaultPort", 2);
+
+    //create test data with keys in the payload bytes
+    const std::vector<unsigned> keys{0, 1, 0x1234, 7, 0, 0xffff};
+    for (const auto key : keys)
+    {
+        Pothos::Packet p;
+        p.payload = Pothos::BufferChunk("int", 10);
+        p.payload.as<unsigned char *>()[2] = (unsigned char)(key >> 8);
+        p.payload.as<unsigned char *>()[3] = (unsigned char)(key >> 0);
+        feeder.call("feedPacket", p);
+    }
+
+    //create the topology
+    Pothos::Topology topology;
+    topology.connect(feeder, 0, demux, 0);
+    topology.connect(demux, 0, collector0, 0);
+    topology.connect(demux, 1, collector1, 0);
+    topology.connect(demux, 2, collector2, 0);
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+
+    //check the result
+    const std::vector<Pothos::Packet> packets0 = collector0.call("getPackets");
+    const std::vector<Pothos::Packet> packets1 = collector1.call("getPackets");
+    const std::vector<Pothos::Packet> packets2 = collector2.call("getPackets");
+    POTHOS_TEST_EQUAL(packets0.size(), 2);
+    POTHOS_TEST_EQUAL(packets1.size(), 2);
+    POTHOS_TEST_EQUAL(packets2.size(), 2);
+    POTHOS_TEST_EQUAL(packets1[1].payload.as<const unsigned char *>()[2], 0x12);
+    POTHOS_TEST_EQUAL(packets2[0].payload.as<const unsigned char *>()[3], 7);
+}
+
+//make a packet that is identified by its first payload byte
+static Pothos::Packet makeDemuxPacket(const unsigned char id)
+{
+    Pothos::Packet p;
+    p.payload = Pothos::BufferChunk("int", 1);
+    p.payload.as<unsigned char *>()[0] = id;
+    return p;
+}
+
+//route the packets and messages, return the packet ids collected on each of 3 outputs
+static std::vector<std::vector<int>> runPacketDemux(Pothos::Proxy demux,
+    const std::vector<Pothos::Packet> &packets, const size_t numMessages, std::vector<size_t> &messagesOut)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    for (const auto &p : packets) feeder.call("feedPacket", p);
+    for (size_t i = 0; i < numMessages; i++) feeder.call("feedMessage", Pothos::Object(int(i)));
+
+    std::vector<Pothos::Proxy> collectors;
+    Pothos::Topology topology;
+    topology.connect(feeder, 0, demux, 0);
+    for (size_t i = 0; i < 3; i++)
+    {
+        collectors.push_back(Pothos::BlockRegistry::make("/blocks/collector_sink", "int"));
+        topology.connect(demux, i, collectors.back(), 0);
+    }
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+
+    std::vector<std::vector<int>> ids(collectors.size());
+    messagesOut.clear();
+    for (size_t i = 0; i < collectors.size(); i++)
+    {
+        const std::vector<Pothos::Packet> collected = collectors[i].call("getPackets");
+        for (const auto &p : collected) ids[i].push_back(p.payload.as<const unsigned char *>()[0]);
+        const std::vector<Pothos::Object> messages = collectors[i].call("getMessages");
+        messagesOut.push_back(messages.size());
+    }
+    return ids;
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_packet_demux_routes)
+{
+    //the default key source is the "sid" metadata entry
+    auto demux = Pothos::BlockRegistry::make("/blocks/packet_demux");
+    demux.call("setNumOutputs", 3);
+    demux.call("setRoutes", std::vector<int>{0, 1});
+    demux.call("setRoute", 4096, 1); //first key in the hash table
+    demux.call("setRoute", 5000, 2);
+    demux.call("setRoute", 3, 2); //grows the lookup table
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 4096)), 1);
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 5000)), 2);
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 4095)), -1);
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 2)), -1);
+    POTHOS_TEST_EQUAL(int(demux.call("getDefaultPort")), -1);
+
+    std::vector<Pothos::Packet> packets;
+    const std::vector<int> sids{0, 1, 5000, 4096, 3, 9, 2};
+    for (size_t i = 0; i < sids.size(); i++)
+    {
+        packets.push_back(makeDemuxPacket((unsigned char)(i)));
+        packets.back().metadata["sid"] = Pothos::Object(sids[i]);
+    }
+    packets.push_back(makeDemuxPacket(7)); //no key
+
+    //unmapped keys, packets without a key, and other messages are dropped
+    std::vector<size_t> messages;
+    auto ids = runPacketDemux(demux, packets, 2, messages);
+    POTHOS_TEST_TRUE(ids[0] == std::vector<int>({0}));
+    POTHOS_TEST_TRUE(ids[1] == std::vector<int>({1, 3}));
+    POTHOS_TEST_TRUE(ids[2] == std::vector<int>({2, 4}));
+    POTHOS_TEST_TRUE(messages == std::vector<size_t>({0, 0, 0}));
+
+    //the default port receives them instead
+    demux.call("setDefaultPort", 0);
+    ids = runPacketDemux(demux, packets, 2, messages);
+    POTHOS_TEST_TRUE(ids[0] == std::vector<int>({0, 5, 6, 7}));
+    POTHOS_TEST_TRUE(ids[1] == std::vector<int>({1, 3}));
+    POTHOS_TEST_TRUE(ids[2] == std::vector<int>({2, 4}));
+    POTHOS_TEST_TRUE(messages == std::vector<size_t>({2, 0, 0}));
+
+    //setRoutes replaces every route, including routes from setRoute
+    demux.call("setRoutes", std::vector<int>{1, 2});
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 4096)), -1);
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 5000)), -1);
+    POTHOS_TEST_EQUAL(int(demux.call("getRoute", 3)), -1);
+    ids = runPacketDemux(demux, packets, 0, messages);
+    POTHOS_TEST_TRUE(ids[0] == std::vector<int>({2, 3, 4, 5, 6, 7}));
+    POTHOS_TEST_TRUE(ids[1] == std::vector<int>({0}));
+    POTHOS_TEST_TRUE(ids[2] == std::vector<int>({1}));
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_packet_demux_labels)
+{
+    //the key is the data of the first label with the key name
+    auto demux = Pothos::BlockRegistry::make("/blocks/packet_demux");
+    demux.call("setNumOutputs", 3);
+    demux.call("setKeySource", "LABEL");
+    demux.call("setKeyName", "route");
+    demux.call("setRoutes", std::vector<int>{2, 1, 0});
+    demux.call("setDefaultPort", 1);
+
+    std::vector<Pothos::Packet> packets;
+    packets.push_back(makeDemuxPacket(0));
+    packets.back().labels.push_back(Pothos::Label("other", 1, 0));
+    packets.back().labels.push_back(Pothos::Label("route", 0, 0));
+    packets.back().labels.push_back(Pothos::Label("route", 2, 0));
+    packets.push_back(makeDemuxPacket(1));
+    packets.back().labels.push_back(Pothos::Label("route", 2, 0));
+    packets.push_back(makeDemuxPacket(2)); //no label -> default port
+    packets.back().labels.push_back(Pothos::Label("other", 0, 0));
+    packets.push_back(makeDemuxPacket(3)); //unmapped key -> default port
+    packets.back().labels.push_back(Pothos::Label("route", 10000, 0));
+
+    std::vector<size_t> messages;
+    const auto ids = runPacketDemux(demux, packets, 1, messages);
+    POTHOS_TEST_TRUE(ids[0] == std::vector<int>({1}));
+    POTHOS_TEST_TRUE(ids[1] == std::vector<int>({2, 3}));
+    POTHOS_TEST_TRUE(ids[2] == std::vector<int>({0}));
+    POTHOS_TEST_TRUE(messages == std::vector<size_t>({0, 1, 0}));
+}
@@ -0,0 +1,283 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "BinaryEncoding.hpp"
+#include <Poco/ByteOrder.h>
+#include <complex>
+#include <sstream>
+#include <cstring>
+
+/***********************************************************************
+ * Type tags -- new tags may be added, existing tags must not change
+ **********************************************************************/
+enum BinaryTag
+{
+    TAG_NULL = 0,
+    TAG_BOOL,
+    TAG_CHAR,
+    TAG_SCHAR,
+    TAG_UCHAR,
+    TAG_SHORT,
+    TAG_USHORT,
+    TAG_INT,
+    TAG_UINT,
+    TAG_LONG,
+    TAG_ULONG,
+    TAG_LLONG,
+    TAG_ULLONG,
+    TAG_FLOAT,
+    TAG_DOUBLE,
+    TAG_CFLOAT,
+    TAG_CDOUBLE,
+    TAG_STRING,
+    TAG_PACKET,
+    TAG_OBJECT = 255, //fallback to the Pothos object serialization
+};
+
+//integer types are always encoded as 64 bits for portability
+#define BINARY_INTEGER_TYPES(X) \
+    X(TAG_BOOL, bool) \
+    X(TAG_CHAR, char) \
+    X(TAG_SCHAR, signed char) \
+    X(TAG_UCHAR, unsigned char) \
+    X(TAG_SHORT, short) \
+    X(TAG_USHORT, unsigned short) \
+    X(TAG_INT, int) \
+    X(TAG_UINT, unsigned int) \
+    X(TAG_LONG, long) \
+    X(TAG_ULONG, unsigned long) \
+    X(TAG_LLONG, long long) \
+    X(TAG_ULLONG, unsigned long long)
+
+static uint32_t floatBits(const float x) {uint32_t u; std::memcpy(&u, &x, 4); return u;}
+static uint64_t doubleBits(const double x) {uint64_t u; std::memcpy(&u, &x, 8); return u;}
+static float bitsFloat(const uint32_t u) {float x; std::memcpy(&x, &u, 4); return x;}
+static double bitsDouble(const uint64_t u) {double x; std::memcpy(&x, &u, 8); return x;}
+
+/***********************************************************************
+ * Encoder
+ **********************************************************************/
+BinaryEncoder::BinaryEncoder(std::string &out):
+    _out(out)
+{
+    _out.clear();
+    this->putU8(BINARY_ENCODING_VERSION);
+}
+
+void BinaryEncoder::encodeLabel(const Pothos::Label &label)
+{
+    this->putString(label.id);
+    this->encodeObject(label.data);
+    this->putU64(label.index);
+    this->putU64(label.width);
+}
+
+void BinaryEncoder::encodeObject(const Pothos::Object &obj)
+{
+    const auto &type = obj.type();
+    if (not obj) return this->putU8(TAG_NULL);
+
+    #define BINARY_ENCODE_INTEGER(tag, T) \
+        if (type == typeid(T)) {this->putU8(tag); return this->putU64(uint64_t(obj.extract<T>()));}
+    BINARY_INTEGER_TYPES(BINARY_ENCODE_INTEGER)
+
+    if (type == typeid(float))
+    {
+        this->putU8(TAG_FLOAT);
+        return this->putU32(floatBits(obj.extract<float>()));
+    }
+    if (type == typeid(double))
+    {
+        this->putU8(TAG_DOUBLE);
+        return this->putU64(doubleBits(obj.extract<double>()));
+    }
+    if (type == typeid(std::complex<float>))
+    {
+        const auto &x = obj.extract<std::complex<float>>();
+        this->putU8(TAG_CFLOAT);
+        this->putU32(floatBits(x.real()));
+        return this->putU32(floatBits(x.imag()));
+    }
+    if (type == typeid(std::complex<double>))
+    {
+        const auto &x = obj.extract<std::complex<double>>();
+        this->putU8(TAG_CDOUBLE);
+        this->putU64(doubleBits(x.real()));
+        return this->putU64(doubleBits(x.imag()));
+    }
+    if (type == typeid(std::string))
+    {
+        this->putU8(TAG_STRING);
+        return this->putString(obj.extract<std::string>());
+    }
+    if (type == typeid(Pothos::Packet))
+    {
+        const auto &packet = obj.extract<Pothos::Packet>();
+        this->putU8(TAG_PACKET);
+        this->putString(packet.payload.dtype.name());
+        this->putU32(uint32_t(packet.payload.dtype.dimension()));
+        this->putU32(uint32_t(packet.payload.length));
+        this->putBytes(packet.payload.as<const void *>(), packet.payload.length);
+        this->putU32(uint32_t(packet.metadata.size()));
+        for (const auto &pair : packet.metadata)
+        {
+            this->putString(pair.first);
+            this->encodeObject(pair.second);
+        }
+        this->putU32(uint32_t(packet.labels.size()));
+        for (const auto &label : packet.labels) this->encodeLabel(label);
+        return;
+    }
+
+    //fallback for all other types
+    std::ostringstream ss;
+    obj.serialize(ss);
+    this->putU8(TAG_OBJECT);
+    this->putString(ss.str());
+}
+
+void BinaryEncoder::putU8(const unsigned char x)
+{
+    _out.push_back(char(x));
+}
+
+void BinaryEncoder::putU32(const uint32_t x)
+{
+    const uint32_t n = Poco::ByteOrder::toNetwork(x);
+    this->putBytes(&n, sizeof(n));
+}
+
+void BinaryEncoder::putU64(const uint64_t x)
+{
+    const Poco::UInt64 n = Poco::ByteOrder::toNetwork(Poco::UInt64(x));
+    this->putBytes(&n, sizeof(n));
+}
+
+void BinaryEncoder::putString(const std::string &s)
+{
+    this->putU32(uint32_t(s.size()));
+    this->putBytes(s.data(), s.size());
+}
+
+void BinaryEncoder::putBytes(const void *p, const size_t len)
+{
+    _out.append(static_cast<const char *>(p), len);
+}
+
+/***********************************************************************
+ * Decoder
+ **********************************************************************/
+BinaryDecoder::BinaryDecoder(const void *buff, const size_t len):
+    _p(static_cast<const unsigned char *>(buff)),
+    _end(_p + len)
+{
+    const auto version = this->getU8();
+    if (version != BINARY_ENCODING_VERSION) throw Pothos::DataFormatException(
+        "BinaryDecoder()", "unsupported version " + std::to_string(version));
+}
+
+bool BinaryDecoder::done(void) const
+{
+    return _p == _end;
+}
+
+Pothos::Label BinaryDecoder::decodeLabel(void)
+{
+    Pothos::Label label;
+    label.id = this->getString();
+    label.data = this->decodeObject();
+    label.index = this->getU64();
+    label.width = size_t(this->getU64());
+    return label;
+}
+
+Pothos::Object BinaryDecoder::decodeObject(void)
+{
+    const auto tag = this->getU8();
+    switch (tag)
+    {
+    case TAG_NULL: return Pothos::Object();
+
+    #define BINARY_DECODE_INTEGER(tag, T) \
+        case tag: return Pothos::Object(static_cast<T>(this->getU64()));
+    BINARY_INTEGER_TYPES(BINARY_DECODE_INTEGER)
+
+    case TAG_FLOAT: return Pothos::Object(bitsFloat(this->getU32()));
+    case TAG_DOUBLE: return Pothos::Object(bitsDouble(this->getU64()));
+    case TAG_CFLOAT:
+    {
+        const float re = bitsFloat(this->getU32());
+        const float im = bitsFloat(this->getU32());
+        return Pothos::Object(std::complex<float>(re, im));
+    }
+    case TAG_CDOUBLE:
+    {
+        const double re = bitsDouble(this->getU64());
+        const double im = bitsDouble(this->getU64());
+        return Pothos::Object(std::complex<double>(re, im));
+    }
+    case TAG_STRING: return Pothos::Object(this->getString());
+    case TAG_PACKET:
+    {
+        Pothos::Packet packet;
+        const auto dtypeName = this->getString();
+        const size_t dimension = this->getU32();
+        const size_t length = this->getU32();
+        const auto bytes = this->take(length);
+        packet.payload = Pothos::BufferChunk(length);
+        packet.payload.dtype = Pothos::DType(dtypeName, dimension);
+        if (length != 0) std::memcpy(packet.payload.as<void *>(), bytes, length);
+        const size_t numMetadata = this->getU32();
+        for (size_t i = 0; i < numMetadata; i++)
+        {
+            const auto key = this->getString();
+            packet.metadata[key] = this->decodeObject();
+        }
+        const size_t numLabels = this->getU32();
+        for (size_t i = 0; i < numLabels; i++) packet.labels.push_back(this->decodeLabel());
+        return Pothos::Object(std::move(packet));
+    }
+    case TAG_OBJECT:
+    {
+        std::istringstream ss(this->getString());
+        Pothos::Object obj;
+        obj.deserialize(ss);
+        return obj;
+    }
+    default: throw Pothos::DataFormatException(
+        "BinaryDecoder::decodeObject()", "unknown tag " + std::to_string(tag));
+    }
+}
+
+const unsigned char *BinaryDecoder::take(const size_t len)
+{
+    if (size_t(_end - _p) < len) throw Pothos::DataFormatException(
+        "BinaryDecoder::take()", "unexpected end of input");
+    const auto p = _p;
+    _p += len;
+    return p;
+}
+
+unsigned char BinaryDecoder::getU8(void)
+{
+    return *this->take(1);
+}
+
+uint32_t BinaryDecoder::getU32(void)
+{
+    uint32_t n; std::memcpy(&n, this->take(sizeof(n)), sizeof(n));
+    return Poco::ByteOrder::fromNetwork(n);
+}
+
+uint64_t BinaryDecoder::getU64(void)
+{
+    Poco::UInt64 n; std::memcpy(&n, this->take(sizeof(n)), sizeof(n));
+    return Poco::ByteOrder::fromNetwork(n);
+}
+
+std::string BinaryDecoder::getString(void)
+{
+    const size_t len = this->getU32();
+    const auto p = this->take(len);
+    return std::string(reinterpret_cast<const char *>(p), len);
+}
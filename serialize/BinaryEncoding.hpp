@@ -0,0 +1,64 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Framework.hpp>
+#include <string>
+#include <cstddef>
+
+/*!
+ * The version of the binary encoding.
+ * Stored as the first byte of each encoded payload.
+ */
+static const unsigned char BINARY_ENCODING_VERSION = 1;
+
+/*!
+ * Compact binary encoding for labels and messages in mVRL extension frames.
+ * Common primitive types, strings, and packets are encoded directly;
+ * other types are encoded with the Pothos object serialization.
+ * All values are stored in network byte order.
+ */
+class BinaryEncoder
+{
+public:
+    //! Encode into the output string, which is cleared first
+    BinaryEncoder(std::string &out);
+
+    void encodeLabel(const Pothos::Label &label);
+
+    void encodeObject(const Pothos::Object &obj);
+
+private:
+    void putU8(const unsigned char x);
+    void putU32(const uint32_t x);
+    void putU64(const uint64_t x);
+    void putString(const std::string &s);
+    void putBytes(const void *p, const size_t len);
+    std::string &_out;
+};
+
+/*!
+ * Decode a payload produced by the binary encoder.
+ * Throws Pothos::DataFormatException on malformed input.
+ */
+class BinaryDecoder
+{
+public:
+    BinaryDecoder(const void *buff, const size_t len);
+
+    //! True when all encoded items have been decoded
+    bool done(void) const;
+
+    Pothos::Label decodeLabel(void);
+
+    Pothos::Object decodeObject(void);
+
+private:
+    const unsigned char *take(const size_t len);
+    unsigned char getU8(void);
+    uint32_t getU32(void);
+    uint64_t getU64(void);
+    std::string getString(void);
+    const unsigned char *_p;
+    const unsigned char *_end;
+};
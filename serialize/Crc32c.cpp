@@ -0,0 +1,96 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Crc32c.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CRC32C_X86
+#include <nmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+/***********************************************************************
+ * Table based implementation -- used when no hardware CRC is available
+ **********************************************************************/
+struct Crc32cTable
+{
+    Crc32cTable(void)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (size_t j = 0; j < 8; j++) crc = (crc >> 1) ^ ((crc & 1)? 0x82f63b78 : 0);
+            table[i] = crc;
+        }
+    }
+    uint32_t table[256];
+};
+
+static uint32_t crc32cTable(uint32_t crc, const unsigned char *p, size_t len)
+{
+    static const Crc32cTable t;
+    while (len--) crc = t.table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+/***********************************************************************
+ * SSE4.2 implementation
+ **********************************************************************/
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2")))
+static uint32_t crc32cSse42(uint32_t crc, const unsigned char *p, size_t len)
+{
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t word; std::memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = uint32_t(crc64);
+    while (len--) crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif //CRC32C_X86
+
+/***********************************************************************
+ * ARMv8 CRC implementation
+ **********************************************************************/
+#ifdef CRC32C_ARM
+static uint32_t crc32cArm(uint32_t crc, const unsigned char *p, size_t len)
+{
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t word; std::memcpy(&word, p, 8);
+        crc = __crc32cd(crc, word);
+    }
+    while (len--) crc = __crc32cb(crc, *p++);
+    return crc;
+}
+#endif //CRC32C_ARM
+
+/***********************************************************************
+ * Runtime dispatch
+ **********************************************************************/
+typedef uint32_t (*Crc32cFcn)(uint32_t, const unsigned char *, size_t);
+
+static Crc32cFcn lookupCrc32c(void)
+{
+    #ifdef CRC32C_X86
+    if (__builtin_cpu_supports("sse4.2")) return &crc32cSse42;
+    #endif
+    #ifdef CRC32C_ARM
+    return &crc32cArm;
+    #endif
+    return &crc32cTable;
+}
+
+uint32_t crc32c(const uint32_t crc, const void *buff, const size_t len)
+{
+    static const Crc32cFcn fcn = lookupCrc32c();
+    return ~fcn(~crc, static_cast<const unsigned char *>(buff), len);
+}
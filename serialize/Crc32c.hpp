@@ -0,0 +1,13 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/*!
+ * Update a CRC32C (Castagnoli) checksum with the contents of a buffer.
+ * Start with a crc of 0 and pass the result in to continue the checksum.
+ * Hardware CRC instructions are used when supported by the CPU.
+ */
+uint32_t crc32c(const uint32_t crc, const void *buff, const size_t len);
@@ -2,12 +2,21 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include "SerializeCommon.hpp"
+#include "Crc32c.hpp"
+#include "Lz4.hpp"
+#include "Zstd.hpp"
+#include "BinaryEncoding.hpp"
 #include <Pothos/Framework.hpp>
 #include <Poco/ByteOrder.h>
 #include <Poco/Format.h>
 #include <sstream>
+#include <vector>
 #include <cstring>
 #include <cassert>
+#include <algorithm> //min/max
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /***********************************************************************
  * |PothosDoc Deserializer
@@ -24,19 +33,96 @@
  * A VRL stream can be stored to file, or sent across a network.
  * In the event of loss, the bounds of the stream can be recovered.
  *
+ * Frames are parsed in-place from the input buffers,
+ * and stream payloads are posted as zero-copy slices of the input.
+ * Only a frame that straddles two input buffers is copied.
+ *
+ * In the event of corruption, the deserializer scans ahead for the mVRL magic word,
+ * and candidate frames are validated against the VEND trailer.
+ * The number of resync events and the number of skipped bytes
+ * are available through the resync count and skipped bytes probes.
+ *
+ * <h2>Loss detection</h2>
+ *
+ * Each frame carries a 12-bit sequence number per stream ID.
+ * When frames are missing, the deserializer posts a "drop" label
+ * on the next output element of the affected port,
+ * where the label data is the number of missing frames.
+ * Labels that arrive after a loss are held until the next stream frame,
+ * whose timestamp locates them in the output stream.
+ * The number of missing frames and the number of missing stream elements
+ * are available through the dropped frames and lost elements probes.
+ *
+ * Compressed frames are decompressed automatically.
+ * Frames compressed with zstd require a module built with zstd.
+ * Frames with a CRC32C checksum are verified before they are handled.
+ * The number of failed checksums is available through the CRC failures probe.
+ *
  * |category /Serialize
  * |keywords deserialize serialize VRL
  *
+ * |param crcMode[CRC Mode] The action to take for frames with a bad checksum.
+ * <ul>
+ * <li>"DROP" - discard the frame</li>
+ * <li>"FLAG" - post the stream payload with a "crcError" label on its first element</li>
+ * </ul>
+ * Labels and messages with a bad checksum are always discarded.
+ * |default "DROP"
+ * |option [Drop] "DROP"
+ * |option [Flag] "FLAG"
+ * |preview valid
+ *
+ * |param maxFrameSize[Max Frame Size] The maximum size of a frame in bytes.
+ * Frames that claim to be larger are treated as corruption.
+ * This must be at least as large as the serializer's max frame size.
+ * |default 131072
+ * |units bytes
+ * |preview valid
+ *
+ * |param maxMessageSize[Max Message Size] The maximum size of a label or message frame in bytes.
+ * Labels and messages are not split by the serializer's max frame size,
+ * so their frames have a separate limit, such as for large packets.
+ * Frames that claim to be larger are treated as corruption.
+ * |default 67108864
+ * |units bytes
+ * |preview valid
+ *
  * |factory /blocks/deserializer()
+ * |setter setCrcMode(crcMode)
+ * |setter setMaxFrameSize(maxFrameSize)
+ * |setter setMaxMessageSize(maxMessageSize)
  **********************************************************************/
 class Deserializer : public Pothos::Block
 {
 public:
     Deserializer(void):
-        _nextExpectedIndex(0)
+        _resyncCount(0),
+        _skippedBytes(0),
+        _inResync(false),
+        _crcFlag(false),
+        _crcFailures(0),
+        _maxFrameSize(MAX_PKT_BYTES),
+        _maxMessageSize(MAX_EXT_PKT_BYTES),
+        _droppedFrames(0),
+        _lostElements(0)
     {
         this->setupInput(0);
         this->setupOutput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getResyncCount));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getSkippedBytes));
+        this->registerProbe("getResyncCount", "probeResyncCount", "resyncCountTriggered");
+        this->registerProbe("getSkippedBytes", "probeSkippedBytes", "skippedBytesTriggered");
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, setCrcMode));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getCrcFailures));
+        this->registerProbe("getCrcFailures", "probeCrcFailures", "crcFailuresTriggered");
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, setMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, setMaxMessageSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getMaxMessageSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getDroppedFrames));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Deserializer, getLostElements));
+        this->registerProbe("getDroppedFrames", "probeDroppedFrames", "droppedFramesTriggered");
+        this->registerProbe("getLostElements", "probeLostElements", "lostElementsTriggered");
     }
 
     static Block *make(void)
@@ -44,12 +130,104 @@ public:
         return new Deserializer();
     }
 
+    unsigned long long getResyncCount(void) const
+    {
+        return _resyncCount;
+    }
+
+    unsigned long long getSkippedBytes(void) const
+    {
+        return _skippedBytes;
+    }
+
+    void setCrcMode(const std::string &mode)
+    {
+        if (mode == "DROP") _crcFlag = false;
+        else if (mode == "FLAG") _crcFlag = true;
+        else throw Pothos::InvalidArgumentException("Deserializer::setCrcMode("+mode+")", "unknown CRC mode");
+    }
+
+    unsigned long long getCrcFailures(void) const
+    {
+        return _crcFailures;
+    }
+
+    void setMaxFrameSize(const size_t maxFrameSize)
+    {
+        _maxFrameSize = maxFrameSize;
+    }
+
+    size_t getMaxFrameSize(void) const
+    {
+        return _maxFrameSize;
+    }
+
+    void setMaxMessageSize(const size_t maxMessageSize)
+    {
+        _maxMessageSize = maxMessageSize;
+    }
+
+    size_t getMaxMessageSize(void) const
+    {
+        return _maxMessageSize;
+    }
+
+    unsigned long long getDroppedFrames(void) const
+    {
+        return _droppedFrames;
+    }
+
+    unsigned long long getLostElements(void) const
+    {
+        return _lostElements;
+    }
+
+    void activate(void)
+    {
+        _streams.clear();
+    }
+
     void work(void);
+    size_t parse(const Pothos::BufferChunk &, const size_t);
     void handlePacket(const Pothos::BufferChunk &);
 
 private:
-    Pothos::BufferChunk _accumulator;
-    unsigned long long _nextExpectedIndex;
+
+    //the receive state for each stream ID
+    struct StreamState
+    {
+        StreamState(void):
+            seqKnown(false),
+            nextSeq(0),
+            started(false),
+            indexKnown(true),
+            nextIndex(0)
+        {
+            return;
+        }
+
+        bool seqKnown;
+        size_t nextSeq;
+        bool started; //a stream frame was received
+        bool indexKnown; //labels can be located in the output stream
+        unsigned long long nextIndex; //the stream index of the next output element
+        std::vector<Pothos::Label> pendingLabels; //held until the index is known
+    };
+
+    void checkSequence(StreamState &state, Pothos::OutputPort *outputPort, const size_t seq);
+    void postLabel(StreamState &state, Pothos::OutputPort *outputPort, Pothos::Label &&label);
+
+    Pothos::BufferChunk _remainder;
+    unsigned long long _resyncCount;
+    unsigned long long _skippedBytes;
+    bool _inResync;
+    bool _crcFlag;
+    unsigned long long _crcFailures;
+    size_t _maxFrameSize;
+    size_t _maxMessageSize;
+    unsigned long long _droppedFrames;
+    unsigned long long _lostElements;
+    std::vector<StreamState> _streams;
 };
 
 static Pothos::BlockRegistry registerDeserializer(
@@ -57,34 +235,87 @@ static Pothos::BlockRegistry registerDeserializer(
 
 /*!
  * Inspect an input buffer for an entire valid packet.
+ * Label and message frames are limited by maxExtBytes.
  */
-static bool inspectPacket(const Pothos::BufferChunk &packet, bool &isFragment, size_t &pkt_bytes)
+static bool inspectPacket(const Pothos::BufferChunk &packet, const size_t maxBytes, const size_t maxExtBytes, bool &isFragment, size_t &pkt_bytes)
 {
     const uint32_t *vrlp_pkt = packet;
     const char *p = packet;
     if ((p[0] == 'm') and (p[1] == 'V') and (p[2] == 'R') and (p[3] == 'L'))
     {
         assert(Poco::ByteOrder::fromNetwork(vrlp_pkt[0]) == mVRL);
-        pkt_bytes = Poco::ByteOrder::fromNetwork(vrlp_pkt[1]) & 0xfffff;
+        pkt_bytes = packetBytes(vrlp_pkt);
+        if (pkt_bytes < MIN_PKT_BYTES) return false; //cant hold the headers
+        const bool is_ext = (Poco::ByteOrder::fromNetwork(vrlp_pkt[2]) & VITA_EXT) != 0;
+        if (pkt_bytes > (is_ext? std::max(maxBytes, maxExtBytes) : maxBytes)) return false; //call this BS
         const size_t pkt_words32 = padUp32(pkt_bytes)/4;
-        isFragment = pkt_bytes > packet.length;
-        if (pkt_bytes > MAX_PKT_BYTES) return false; //call this BS
+        isFragment = pkt_words32*4 > packet.length;
         return isFragment or Poco::ByteOrder::fromNetwork(vrlp_pkt[pkt_words32-1]) == VEND;
     }
     return false;
 }
 
+/*!
+ * Find the offset of the next possible mVRL magic word in [begin, end).
+ * The caller guarantees that 4 bytes are readable after each offset.
+ * Return end when no candidate is found.
+ */
+static size_t findMagic(const char *p, size_t begin, const size_t end)
+{
+    #ifdef __SSE2__
+    //compare 16 offsets at once for the first two magic bytes
+    const __m128i m = _mm_set1_epi8('m');
+    const __m128i V = _mm_set1_epi8('V');
+    for (; begin + 16 <= end; begin += 16)
+    {
+        const __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + begin));
+        const __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + begin + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x0, m), _mm_cmpeq_epi8(x1, V)));
+        while (mask != 0)
+        {
+            const int i = __builtin_ctz(mask);
+            if (p[begin+i+2] == 'R' and p[begin+i+3] == 'L') return begin+i;
+            mask &= mask-1;
+        }
+    }
+    #endif
+
+    while (begin < end)
+    {
+        const void *found = std::memchr(p + begin, 'm', end - begin);
+        if (found == nullptr) return end;
+        begin = size_t(static_cast<const char *>(found) - p);
+        if (std::memcmp(p + begin, "mVRL", 4) == 0) return begin;
+        begin++;
+    }
+    return end;
+}
+
+/*!
+ * Verify the CRC32C of a complete packet.
+ * Return true when the packet has no checksum.
+ */
+static bool checkCrc(const Pothos::BufferChunk &packet)
+{
+    const uint32_t *p = packet;
+    if ((Poco::ByteOrder::fromNetwork(p[2]) & VITA_CRC) == 0) return true;
+    const size_t pkt_bytes = packetBytes(p);
+    const size_t pkt_words32 = padUp32(pkt_bytes)/4;
+    if (pkt_words32 < 6) return false; //too small for header + crc + trailer
+    return crc32c(0, p, (pkt_words32-2)*4) == Poco::ByteOrder::fromNetwork(p[pkt_words32-2]);
+}
+
 /*!
  * Unpack a buffer containing a packet into the header and payload contents.
  */
-static void unpackBuffer(const Pothos::BufferChunk &packet, size_t &seq, size_t &sid, bool &has_tsf, unsigned long long &tsf, bool &is_ext, Pothos::BufferChunk &payloadBuff)
+static void unpackBuffer(const Pothos::BufferChunk &packet, size_t &seq, size_t &sid, bool &has_tsf, unsigned long long &tsf, bool &is_ext, bool &is_lz4, bool &is_zstd, bool &is_bin, Pothos::BufferChunk &payloadBuff)
 {
     #define unpackCheck(cond) if (not (cond)) throw Pothos::AssertionViolationException("Deserializer::unpackBuffer()", "failed assertion: " #cond)
     const uint32_t *p = packet;
 
     //validate vrlp
     assert(Poco::ByteOrder::fromNetwork(p[0]) == mVRL);
-    const size_t pkt_bytes = Poco::ByteOrder::fromNetwork(p[1]) & 0xfffff;
+    const size_t pkt_bytes = packetBytes(p);
     const size_t pkt_words32 = padUp32(pkt_bytes)/4;
     assert(Poco::ByteOrder::fromNetwork(p[pkt_words32-1]) == VEND);
     unpackCheck(pkt_words32*4 <= packet.length);
@@ -93,35 +324,39 @@ static void unpackBuffer(const Pothos::BufferChunk &packet, size_t &seq, size_t
     //validate vita
     const auto vita_hdr = Poco::ByteOrder::fromNetwork(p[2]);
     const size_t vita_words32 = vita_hdr & 0xffff;
-    unpackCheck(vita_words32 == pkt_words32 - 3);
+    const bool has_xlen = bool(vita_hdr & VITA_XLEN);
+    unpackCheck(vita_words32 == (has_xlen? 0 : pkt_words32 - 3));
 
     //validate seq
     const size_t seq4 = (vita_hdr >> 16) & 0xf;
-    unpackCheck((seq12 & 0x4) == seq4);
+    unpackCheck((seq12 & 0xf) == seq4);
 
     has_tsf = bool(vita_hdr & VITA_TSF);
     unpackCheck(bool(vita_hdr & VITA_SID));
     is_ext = bool(vita_hdr & VITA_EXT);
+    is_lz4 = bool(vita_hdr & VITA_LZ4);
+    is_zstd = bool(vita_hdr & VITA_ZSTD);
+    is_bin = bool(vita_hdr & VITA_BIN);
+    const bool has_crc = bool(vita_hdr & VITA_CRC);
 
     //assert other fields are blank - expected
     unpackCheck((vita_hdr & (1 << 30)) == 0);
-    unpackCheck((vita_hdr & (1 << 27)) == 0);
-    unpackCheck((vita_hdr & (1 << 26)) == 0);
-    unpackCheck((vita_hdr & (1 << 23)) == 0);
-    unpackCheck((vita_hdr & (1 << 22)) == 0);
 
     //extract seq and sid
     seq = seq12;
     sid = Poco::ByteOrder::fromNetwork(p[3]);
 
-    //only valid when has_tsf
-    tsf = (uint64_t(Poco::ByteOrder::fromNetwork(p[4])) << 32) | Poco::ByteOrder::fromNetwork(p[5]);
+    //only valid when has_tsf, follows the extended length word
+    const size_t tsf_word = has_xlen? 5 : 4;
+    tsf = (uint64_t(Poco::ByteOrder::fromNetwork(p[tsf_word])) << 32) | Poco::ByteOrder::fromNetwork(p[tsf_word+1]);
 
     //set out buff
-    const size_t hdr_words32 = has_tsf? 6 : 4;
+    const size_t hdr_words32 = (has_tsf? 6 : 4) + (has_xlen? 1 : 0);
     payloadBuff = packet;
     payloadBuff.address += hdr_words32*4;
-    payloadBuff.length = pkt_bytes - hdr_words32*4 - 4;
+    const size_t tlr_words32 = has_crc? 2 : 1;
+    unpackCheck(pkt_bytes >= (hdr_words32 + tlr_words32)*4);
+    payloadBuff.length = pkt_bytes - (hdr_words32 + tlr_words32)*4;
 }
 
 void Deserializer::work(void)
@@ -130,35 +365,87 @@ void Deserializer::work(void)
     auto buff = inputPort->buffer();
     inputPort->consume(buff.length);
 
-    //TODO use an iovec approach to avoid accumulating
+    //resolve a frame that straddles the previous and current buffer:
+    //copy the remainder and only as much of the new buffer as needed
+    while (_remainder.length != 0 and buff.length != 0)
+    {
+        bool isFragment = false; size_t pkt_bytes = 0;
+        size_t need = MIN_PKT_BYTES;
+        if (_remainder.length >= MIN_PKT_BYTES and
+            inspectPacket(_remainder, _maxFrameSize, _maxMessageSize, isFragment, pkt_bytes) and
+            isFragment) need = padUp32(pkt_bytes) - _remainder.length;
+        const size_t take = std::min(buff.length, need);
+
+        Pothos::BufferChunk joined(_remainder.length + take);
+        std::memcpy(joined.as<char *>(), _remainder.as<const char *>(), _remainder.length);
+        std::memcpy(joined.as<char *>() + _remainder.length, buff.as<const char *>(), take);
 
-    _accumulator.append(buff);
+        //parse frames that begin in the remainder
+        const size_t consumed = this->parse(joined, _remainder.length);
+        if (consumed >= _remainder.length)
+        {
+            buff.address += consumed - _remainder.length;
+            buff.length -= consumed - _remainder.length;
+            _remainder = Pothos::BufferChunk();
+        }
+        else
+        {
+            joined.address += consumed;
+            joined.length -= consumed;
+            _remainder = joined;
+            buff.address += take;
+            buff.length -= take;
+        }
+    }
 
-    //character by character recovery search for packet header
-    while (_accumulator.length >= MIN_PKT_BYTES)
+    //parse frames in-place from the input buffer
+    if (_remainder.length == 0 and buff.length != 0)
     {
+        const size_t consumed = this->parse(buff, buff.length);
+        buff.address += consumed;
+        buff.length -= consumed;
+        _remainder = buff;
+    }
+
+    //dont keep a reference if the buffer is empty
+    if (_remainder.length == 0) _remainder = Pothos::BufferChunk();
+}
+
+/*!
+ * Parse and handle all complete frames that begin before the limit.
+ * Return the number of bytes consumed from the start of the buffer.
+ */
+size_t Deserializer::parse(const Pothos::BufferChunk &buff, const size_t limit)
+{
+    Pothos::BufferChunk packet = buff;
+    size_t offset = 0;
+
+    while (offset < limit and buff.length - offset >= MIN_PKT_BYTES)
+    {
+        packet.address = buff.address + offset;
+        packet.length = buff.length - offset;
+
         bool isFragment = true; size_t pkt_bytes = 0;
-        if (inspectPacket(_accumulator, isFragment, pkt_bytes))
+        if (inspectPacket(packet, _maxFrameSize, _maxMessageSize, isFragment, pkt_bytes))
         {
-            if (isFragment) return; //wait for more incoming buffers to accumulate
-            this->handlePacket(_accumulator); //handle the packet, its good probably
-
-            //increment for the next iteration
-            assert(pkt_bytes <= _accumulator.length);
-            _accumulator.address += pkt_bytes;
-            _accumulator.length -= pkt_bytes;
-            assert(_accumulator.length <= _accumulator.getBuffer().getLength());
+            if (isFragment) break; //wait for more incoming buffers
+            this->handlePacket(packet); //handle the packet, its good probably
+            offset += padUp32(pkt_bytes); //frames are padded to 32-bit words
+            if (_inResync) _resyncCount++;
+            _inResync = false;
         }
         else
         {
-            //the search continues
-            _accumulator.address++;
-            _accumulator.length--;
+            //the search continues at the next candidate magic word
+            const size_t end = std::min(limit, buff.length - MIN_PKT_BYTES + 1);
+            const size_t next = findMagic(buff.as<const char *>(), offset+1, end);
+            _skippedBytes += next - offset;
+            _inResync = true;
+            offset = next;
         }
     }
 
-    //dont keep a reference if the buffer is empty
-    if (_accumulator.length == 0) _accumulator = Pothos::BufferChunk();
+    return offset;
 }
 
 /*!
@@ -166,42 +453,164 @@ void Deserializer::work(void)
  */
 void Deserializer::handlePacket(const Pothos::BufferChunk &packetBuff)
 {
+    //verify the checksum before trusting the header
+    const bool crcError = not checkCrc(packetBuff);
+    if (crcError)
+    {
+        _crcFailures++;
+        if (not _crcFlag) return;
+    }
+
     //extract info
     size_t seq = 0;
     size_t sid = 0;
     bool has_tsf = false;
     unsigned long long tsf = 0;
     bool is_ext = false;
+    bool is_lz4 = false;
+    bool is_zstd = false;
+    bool is_bin = false;
     Pothos::BufferChunk payloadBuff;
-    unpackBuffer(packetBuff, seq, sid, has_tsf, tsf, is_ext, payloadBuff);
+    try
+    {
+        unpackBuffer(packetBuff, seq, sid, has_tsf, tsf, is_ext, is_lz4, is_zstd, is_bin, payloadBuff);
+    }
+    catch (const Pothos::Exception &)
+    {
+        if (not crcError) throw;
+        return; //the header is corrupt, there is nothing to flag
+    }
+
+    //corrupt labels and messages cannot be deserialized
+    if (crcError and (is_ext or sid >= this->outputs().size())) return;
 
     if (sid >= this->outputs().size()) throw Pothos::RangeException("Deserializer::handlePacket()",
         Poco::format("packet has SID %z, but block has %z outputs", sid, this->outputs().size()));
     auto outputPort = this->output(sid);
+    if (sid >= _streams.size()) _streams.resize(sid+1);
+    auto &state = _streams[sid];
+
+    //the sequence of a corrupt frame cannot be trusted,
+    //so a flagged frame takes the next expected sequence number
+    if (not crcError) this->checkSequence(state, outputPort, seq);
+    else if (state.seqKnown) state.nextSeq = (state.nextSeq + 1) & 0xfff;
+
+    //decompress the payload into a new buffer
+    if (is_lz4 or is_zstd)
+    {
+        uint32_t len = 0;
+        if (payloadBuff.length >= LZ4_HDR_BYTES) std::memcpy(&len, payloadBuff.as<const void *>(), LZ4_HDR_BYTES);
+        len = Poco::ByteOrder::fromNetwork(len);
+        const bool lenOk = payloadBuff.length >= LZ4_HDR_BYTES and len <= (is_ext? std::max(_maxFrameSize, _maxMessageSize) : _maxFrameSize);
+        auto outBuff = lenOk? (is_ext? Pothos::BufferChunk(len) : outputPort->getBuffer(len)) : Pothos::BufferChunk();
+        const char *src = payloadBuff.as<const char *>() + LZ4_HDR_BYTES;
+        const size_t srcLen = payloadBuff.length - LZ4_HDR_BYTES;
+        if (not lenOk or not (is_zstd?
+            zstdDecompress(src, srcLen, outBuff.as<void *>(), len):
+            lz4Decompress(src, srcLen, outBuff.as<void *>(), len)))
+        {
+            if (crcError) return; //the payload is corrupt, there is nothing to flag
+            if (is_zstd and not zstdAvailable()) throw Pothos::NotImplementedException("Deserializer::handlePacket()", "zstd frame, built without zstd");
+            throw Pothos::DataFormatException("Deserializer::handlePacket()", std::string(is_zstd? "zstd" : "LZ4") + " decompression failed");
+        }
+        outBuff.length = len;
+        payloadBuff = std::move(outBuff);
+    }
 
     //handle buffs
     if (not is_ext)
     {
         assert(has_tsf);
-        _nextExpectedIndex = tsf + payloadBuff.length;
+        if (state.started and tsf > state.nextIndex) _lostElements += tsf - state.nextIndex;
+        state.started = true;
+
+        //the timestamp locates the labels that were held since a loss
+        state.nextIndex = tsf;
+        state.indexKnown = true;
+        for (auto &lbl : state.pendingLabels) this->postLabel(state, outputPort, std::move(lbl));
+        state.pendingLabels.clear();
+
+        state.nextIndex = tsf + payloadBuff.length;
+        if (crcError) outputPort->postLabel(Pothos::Label("crcError", payloadBuff.length, 0));
         outputPort->postBuffer(std::move(payloadBuff));
     }
 
+    //binary encoded labels and messages
+    else if (is_bin)
+    {
+        BinaryDecoder decoder(payloadBuff.as<const void *>(), payloadBuff.length);
+        if (has_tsf)
+        {
+            unsigned long long firstIndex = 0;
+            for (bool first = true; first or not decoder.done(); first = false)
+            {
+                auto lbl = decoder.decodeLabel();
+                if (first) firstIndex = lbl.index;
+                lbl.index = tsf + (lbl.index - firstIndex);
+                this->postLabel(state, outputPort, std::move(lbl));
+            }
+        }
+        else outputPort->postMessage(decoder.decodeObject());
+    }
+
     else
     {
         std::stringstream ss(std::string(payloadBuff.as<const char *>(), payloadBuff.length));
         Pothos::Object obj;
         obj.deserialize(ss);
 
-        //handle labels
+        //handle labels: the first label is located by the timestamp,
+        //and additional labels in a batch are located relative to the first
         if (has_tsf)
         {
-            auto &lbl = obj.ref<Pothos::Label>();
-            lbl.index = tsf - _nextExpectedIndex;
-            outputPort->postLabel(std::move(lbl));
+            const auto firstIndex = obj.ref<Pothos::Label>().index;
+            while (true)
+            {
+                auto &lbl = obj.ref<Pothos::Label>();
+                lbl.index = tsf + (lbl.index - firstIndex);
+                this->postLabel(state, outputPort, std::move(lbl));
+                if (ss.peek() == std::char_traits<char>::eof()) break;
+                obj.deserialize(ss);
+            }
         }
 
         //handle msgs
         else outputPort->postMessage(std::move(obj));
     }
 }
+
+/*!
+ * Check the sequence number of a frame for missing frames.
+ */
+void Deserializer::checkSequence(StreamState &state, Pothos::OutputPort *outputPort, const size_t seq)
+{
+    if (not state.seqKnown)
+    {
+        //the stream was joined after it started (such as after a seek),
+        //so labels are held until a stream frame locates them
+        state.seqKnown = true;
+        if (seq != 0) state.indexKnown = false;
+    }
+
+    //a repeated sequence number is not a loss:
+    //older serializers write zero for every frame
+    else if (seq != state.nextSeq and seq != ((state.nextSeq - 1) & 0xfff))
+    {
+        const unsigned long long missing = (seq - state.nextSeq) & 0xfff;
+        _droppedFrames += missing;
+        outputPort->postLabel(Pothos::Label("drop", missing, 0));
+        state.indexKnown = false;
+    }
+
+    state.nextSeq = (seq + 1) & 0xfff;
+}
+
+/*!
+ * Post a label with an absolute stream index to the output port.
+ */
+void Deserializer::postLabel(StreamState &state, Pothos::OutputPort *outputPort, Pothos::Label &&label)
+{
+    if (not state.indexKnown) return state.pendingLabels.push_back(std::move(label));
+    label.index = (label.index > state.nextIndex)? label.index - state.nextIndex : 0;
+    outputPort->postLabel(std::move(label));
+}
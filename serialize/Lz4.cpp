@@ -0,0 +1,158 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Lz4.hpp"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm> //min
+
+/***********************************************************************
+ * An implementation of the LZ4 block format:
+ * A block is a series of sequences, each sequence has a token,
+ * literal bytes, a 16-bit little endian match offset, and a match length.
+ * The last sequence has only literals and the last 5 bytes are literals.
+ **********************************************************************/
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;
+static const size_t MF_LIMIT = 12;
+static const size_t MAX_OFFSET = 65535;
+static const size_t HASH_LOG = 12;
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t x; std::memcpy(&x, p, 4);
+    return x;
+}
+
+static inline uint32_t hash32(const uint32_t x)
+{
+    return (x*2654435761U) >> (32-HASH_LOG);
+}
+
+//write a length extension of 255 valued bytes and the remainder
+static inline uint8_t *writeLength(uint8_t *op, size_t len)
+{
+    for (; len >= 255; len -= 255) *op++ = 255;
+    *op++ = uint8_t(len);
+    return op;
+}
+
+//write a sequence with literals from anchor and an optional match
+static bool writeSequence(uint8_t *&op, const uint8_t *oend,
+    const uint8_t *anchor, const size_t numLiterals,
+    const size_t offset, const size_t matchLen)
+{
+    //worst case size of this sequence
+    if (size_t(oend - op) < 1 + numLiterals/255 + 1 + numLiterals + 2 + matchLen/255 + 1) return false;
+
+    uint8_t *token = op++;
+    *token = uint8_t(std::min<size_t>(numLiterals, 15) << 4);
+    if (numLiterals >= 15) op = writeLength(op, numLiterals-15);
+    if (numLiterals != 0) std::memcpy(op, anchor, numLiterals);
+    op += numLiterals;
+
+    if (matchLen == 0) return true; //last literals only
+    *op++ = uint8_t(offset);
+    *op++ = uint8_t(offset >> 8);
+    const size_t code = matchLen - MIN_MATCH;
+    *token |= uint8_t(std::min<size_t>(code, 15));
+    if (code >= 15) op = writeLength(op, code-15);
+    return true;
+}
+
+size_t lz4Compress(const void *src, const size_t srcLen, void *dst, const size_t dstCapacity)
+{
+    const auto base = static_cast<const uint8_t *>(src);
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *const iend = base + srcLen;
+    auto op = static_cast<uint8_t *>(dst);
+    const uint8_t *const oend = op + dstCapacity;
+
+    if (srcLen > MF_LIMIT)
+    {
+        const uint8_t *const mflimit = iend - MF_LIMIT;
+        const uint8_t *const matchlimit = iend - LAST_LITERALS;
+        std::vector<uint32_t> table(1 << HASH_LOG, 0);
+
+        while (ip < mflimit)
+        {
+            const uint32_t seq = read32(ip);
+            const uint32_t h = hash32(seq);
+            const uint8_t *ref = base + table[h];
+            table[h] = uint32_t(ip - base);
+
+            if (ref >= ip or size_t(ip - ref) > MAX_OFFSET or read32(ref) != seq)
+            {
+                //skip faster through incompressible data
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            //extend the match backwards and forwards
+            while (ip > anchor and ref > base and ip[-1] == ref[-1]) {ip--; ref--;}
+            const uint8_t *mp = ip + MIN_MATCH;
+            const uint8_t *rp = ref + MIN_MATCH;
+            while (mp < matchlimit and *mp == *rp) {mp++; rp++;}
+
+            if (not writeSequence(op, oend, anchor, size_t(ip - anchor), size_t(ip - ref), size_t(mp - ip))) return 0;
+            ip = anchor = mp;
+        }
+    }
+
+    if (not writeSequence(op, oend, anchor, size_t(iend - anchor), 0, 0)) return 0;
+    return size_t(op - static_cast<uint8_t *>(dst));
+}
+
+//read a length extension, return false on overrun
+static inline bool readLength(const uint8_t *&ip, const uint8_t *iend, size_t &len)
+{
+    uint8_t b = 255;
+    while (b == 255)
+    {
+        if (ip >= iend) return false;
+        b = *ip++;
+        len += b;
+    }
+    return true;
+}
+
+bool lz4Decompress(const void *src, const size_t srcLen, void *dst, const size_t dstLen)
+{
+    auto ip = static_cast<const uint8_t *>(src);
+    const uint8_t *const iend = ip + srcLen;
+    const auto base = static_cast<uint8_t *>(dst);
+    uint8_t *op = base;
+    uint8_t *const oend = base + dstLen;
+
+    while (ip < iend)
+    {
+        const uint8_t token = *ip++;
+
+        //copy the literals
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 and not readLength(ip, iend, numLiterals)) return false;
+        if (size_t(iend - ip) < numLiterals or size_t(oend - op) < numLiterals) return false;
+        std::memcpy(op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+        if (ip == iend) break; //last sequence
+
+        //copy the match, which may overlap the output
+        if (iend - ip < 2) return false;
+        const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 or offset > size_t(op - base)) return false;
+        size_t matchLen = token & 15;
+        if (matchLen == 15 and not readLength(ip, iend, matchLen)) return false;
+        matchLen += MIN_MATCH;
+        if (size_t(oend - op) < matchLen) return false;
+        const uint8_t *ref = op - offset;
+        if (offset >= matchLen) std::memcpy(op, ref, matchLen);
+        else for (size_t i = 0; i < matchLen; i++) op[i] = ref[i];
+        op += matchLen;
+    }
+
+    return op == oend;
+}
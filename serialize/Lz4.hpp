@@ -0,0 +1,27 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+
+/*!
+ * The worst case compressed size for an input of the given size.
+ */
+static inline size_t lz4CompressBound(const size_t len)
+{
+    return len + len/255 + 16;
+}
+
+/*!
+ * Compress a buffer into the LZ4 block format.
+ * Return the number of compressed bytes,
+ * or 0 when the output does not fit in dstCapacity.
+ */
+size_t lz4Compress(const void *src, const size_t srcLen, void *dst, const size_t dstCapacity);
+
+/*!
+ * Decompress a buffer in the LZ4 block format.
+ * Return true when the input decompressed to exactly dstLen bytes.
+ * Malformed input is detected and never reads or writes out of bounds.
+ */
+bool lz4Decompress(const void *src, const size_t srcLen, void *dst, const size_t dstLen);
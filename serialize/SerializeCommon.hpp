@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #pragma once
+#include <Poco/ByteOrder.h>
 #include <cstdint>
 #include <cstddef>
 
@@ -27,12 +28,48 @@ static const uint32_t VEND = 0
 static const int VITA_SID = (1 << 28);
 static const int VITA_EXT = (1 << 29);
 static const int VITA_TSF = (1 << 20);
+static const int VITA_CRC = (1 << 26); //trailer has a CRC32C before VEND
+static const int VITA_XLEN = (1 << 27); //extended length word follows the SID
+static const int VITA_LZ4 = (1 << 23); //payload is compressed with LZ4
+static const int VITA_BIN = (1 << 22); //ext payload uses the binary encoding
+static const int VITA_ZSTD = (1 << 24); //payload is compressed with zstd
 
 //minimum packet size given headers + footers
 static const size_t MIN_PKT_BYTES = 20;
 
-//needed to fit headers and footers
-static const size_t HDR_TLR_BYTES = 8*4;
+//needed to fit headers and footers (including the optional CRC and extended length)
+static const size_t HDR_TLR_BYTES = 9*4;
+static const size_t CRC_BYTES = 4;
+
+//compressed payloads (LZ4 and zstd) begin with the uncompressed length
+static const size_t LZ4_HDR_BYTES = 4;
 
 //we need a practical limit because VRL packets can be 3 MiB
+//this is the default limit, larger frames are configurable
 static const size_t MAX_PKT_BYTES = 128*1024;
+
+//labels and messages are not split into frames,
+//so their frames have a separate and larger default limit
+static const size_t MAX_EXT_PKT_BYTES = 64*1024*1024;
+
+/*!
+ * Does a packet of this size need the extended length header word?
+ * The length field holds 20 bits and the VITA size field holds 16 bits.
+ */
+static inline bool needsExtLen(const size_t pkt_bytes)
+{
+    return pkt_bytes > 0xfffff or padUp32(pkt_bytes)/4 - 3 > 0xffff;
+}
+
+/*!
+ * Get the size of a packet in bytes from the header.
+ * Large packets hold the size in the extended length word.
+ * The packet must have at least MIN_PKT_BYTES readable.
+ */
+static inline size_t packetBytes(const uint32_t *p)
+{
+    const size_t pkt_bytes = Poco::ByteOrder::fromNetwork(p[1]) & 0xfffff;
+    if (pkt_bytes != 0) return pkt_bytes;
+    if ((Poco::ByteOrder::fromNetwork(p[2]) & VITA_XLEN) == 0) return 0;
+    return Poco::ByteOrder::fromNetwork(p[4]);
+}
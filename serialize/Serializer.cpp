@@ -2,12 +2,105 @@
 // SPDX-License-Identifier: BSL-1.0
 
 #include "SerializeCommon.hpp"
+#include "Crc32c.hpp"
+#include "Lz4.hpp"
+#include "Zstd.hpp"
+#include "BinaryEncoding.hpp"
+#include "WorkerPool.hpp"
 #include <Pothos/Framework.hpp>
 #include <Poco/ByteOrder.h>
 #include <sstream>
+#include <deque>
+#include <map>
+#include <algorithm> //min/max
+#include <memory>
 #include <cstring>
 #include <cassert>
 
+/***********************************************************************
+ * Input buffer manager with reserved space around each buffer:
+ * The serializer writes the frame header into the headroom and the
+ * trailer into the tailroom so the frame is posted as one buffer.
+ **********************************************************************/
+static const size_t HEADROOM_BYTES = 7*4; //headers with tsf and extended length
+static const size_t TAILROOM_BYTES = 3*4; //padding + crc + trailer
+
+class FramingBufferManager :
+    public Pothos::BufferManager,
+    public std::enable_shared_from_this<FramingBufferManager>
+{
+public:
+    FramingBufferManager(void):
+        _bufferSize(0),
+        _slotSize(0)
+    {
+        return;
+    }
+
+    void init(const Pothos::BufferManagerArgs &args)
+    {
+        Pothos::BufferManager::init(args);
+        _bufferSize = args.bufferSize;
+        _slotSize = padUp32(HEADROOM_BYTES + args.bufferSize + TAILROOM_BYTES);
+
+        //allocate one large continuous slab
+        _slab = Pothos::SharedBuffer::make(_slotSize*args.numBuffers, args.nodeAffinity);
+
+        //create managed buffers based on slots from the slab,
+        //the buffers are pushed to the queue on destruction
+        std::vector<Pothos::ManagedBuffer> managedBuffers(args.numBuffers);
+        for (size_t i = 0; i < args.numBuffers; i++)
+        {
+            Pothos::SharedBuffer sharedBuff(_slab.getAddress()+_slotSize*i, _slotSize, _slab);
+            managedBuffers[i].reset(this->shared_from_this(), sharedBuff, i);
+        }
+    }
+
+    bool empty(void) const
+    {
+        return _readyBuffs.empty();
+    }
+
+    void pop(const size_t)
+    {
+        assert(not _readyBuffs.empty());
+        _readyBuffs.pop_front();
+        this->updateFront();
+    }
+
+    void push(const Pothos::ManagedBuffer &buff)
+    {
+        _readyBuffs.push_back(buff);
+        if (_readyBuffs.size() == 1) this->updateFront();
+    }
+
+    /*!
+     * Does this buffer begin at the start of one of our slots,
+     * so the headroom and tailroom can be used for framing?
+     */
+    bool hasRoom(const Pothos::BufferChunk &buff) const
+    {
+        if (_slotSize == 0 or buff.length > _bufferSize) return false;
+        if (buff.getBuffer().getContainer() != _slab.getContainer()) return false;
+        return ((buff.address - _slab.getAddress()) % _slotSize) == HEADROOM_BYTES;
+    }
+
+private:
+    void updateFront(void)
+    {
+        if (_readyBuffs.empty()) return this->setFrontBuffer(Pothos::BufferChunk());
+        Pothos::BufferChunk front(_readyBuffs.front());
+        front.address += HEADROOM_BYTES;
+        front.length = _bufferSize;
+        this->setFrontBuffer(front);
+    }
+
+    size_t _bufferSize;
+    size_t _slotSize;
+    Pothos::SharedBuffer _slab;
+    std::deque<Pothos::ManagedBuffer> _readyBuffs;
+};
+
 /***********************************************************************
  * |PothosDoc Serializer
  *
@@ -15,6 +108,7 @@
  * The mVRL stream encapsulates input streams, labels, and messages.
  * The streaming data is left in its original binary format.
  * The contents of the labels and messages are serialized.
+ * All labels available on a port are batched into a single frame.
  * The input ports are indexed starting at 0 and incrementing.
  * The serializer outputs a byte stream containing mVRL on port 0.
  *
@@ -26,15 +120,127 @@
  * |category /Serialize
  * |keywords serialize VRL
  *
+ * |param inPlaceFraming[In-place Framing] Frame stream buffers in-place.
+ * When enabled, the input buffers reserve space before and after the payload,
+ * and the header and trailer are written around the payload in-place.
+ * Each frame is posted downstream as a single contiguous buffer.
+ * Otherwise, the header, payload, and trailer are posted as separate buffers.
+ * This option must be set before the topology is committed.
+ * |option [Enabled] true
+ * |option [Disabled] false
+ * |default false
+ * |preview valid
+ *
+ * |param crcEnabled[CRC Enabled] Append a CRC32C checksum to each frame.
+ * The checksum covers the header, payload, and padding of the frame,
+ * and it is verified by the deserializer to detect corrupt frames.
+ * Hardware CRC instructions are used when supported by the CPU.
+ * |option [Enabled] true
+ * |option [Disabled] false
+ * |default false
+ * |preview valid
+ *
+ * |param maxFrameSize[Max Frame Size] The maximum size of a frame in bytes.
+ * Stream buffers that do not fit in a single frame are split into multiple frames.
+ * Labels and messages, such as large packets, are always sent in one frame
+ * that may exceed this size, up to the deserializer's max message size.
+ * Frames that do not fit the 16-bit VITA word count (larger than about 256 KiB)
+ * use an extended length header word.
+ * The deserializer's max frame size must be at least this large.
+ * |default 131072
+ * |units bytes
+ * |preview valid
+ *
+ * |param compression[Compression] Compress the payload of each frame.
+ * Each frame is compressed independently so that the deserializer
+ * can still recover the stream after loss or corruption.
+ * Frames that do not compress are sent uncompressed.
+ * Large buffers that span multiple frames are compressed in parallel
+ * when the number of compression workers is non-zero.
+ * <ul>
+ * <li>"NONE" - no compression</li>
+ * <li>"LZ4" - fast compression in the LZ4 block format</li>
+ * <li>"ZSTD" - higher compression with zstd, when the module was built with zstd</li>
+ * </ul>
+ * |default "NONE"
+ * |option [None] "NONE"
+ * |option [LZ4] "LZ4"
+ * |option [ZSTD] "ZSTD"
+ * |preview valid
+ *
+ * |param compressionLevel[Compression Level] The zstd compression level.
+ * Higher levels compress better at a lower speed, negative levels are the fastest.
+ * The level does not apply to LZ4 compression.
+ * |default 3
+ * |widget SpinBox(minimum=-7, maximum=22)
+ * |preview valid
+ *
+ * |param numWorkers[Num Workers] The number of extra threads for parallel compression.
+ * The threads are created when the block is activated and reused for each buffer.
+ * A value of 0 (default) compresses on the calling thread.
+ * |default 0
+ * |widget SpinBox(minimum=0)
+ * |preview disable
+ *
+ * |param portBudget[Port Budget] The maximum number of stream bytes per input port per work call.
+ * The input ports are served in round-robin order with a rotating start port,
+ * so that one busy port cannot stall the other ports.
+ * A budget of 0 (default) serializes all available bytes from each port.
+ * |default 0
+ * |units bytes
+ * |preview valid
+ *
+ * |param encoding[Encoding] The encoding for the contents of labels and messages.
+ * <ul>
+ * <li>"POTHOS" - the Pothos object serialization, readable by all deserializers</li>
+ * <li>"BINARY" - a compact binary encoding for common label data types and packets,
+ * other types fall back to the Pothos object serialization inside the binary encoding</li>
+ * </ul>
+ * |default "POTHOS"
+ * |option [Pothos] "POTHOS"
+ * |option [Binary] "BINARY"
+ * |preview valid
+ *
  * |factory /blocks/serializer()
+ * |setter setInPlaceFraming(inPlaceFraming)
+ * |setter setCrcEnabled(crcEnabled)
+ * |setter setMaxFrameSize(maxFrameSize)
+ * |setter setCompression(compression)
+ * |setter setCompressionLevel(compressionLevel)
+ * |setter setNumWorkers(numWorkers)
+ * |setter setPortBudget(portBudget)
+ * |setter setEncoding(encoding)
  **********************************************************************/
 class Serializer : public Pothos::Block
 {
 public:
-    Serializer(void)
+    Serializer(void):
+        _inPlaceFraming(false),
+        _crcEnabled(false),
+        _maxFrameSize(MAX_PKT_BYTES),
+        _compression(0),
+        _compressionLevel(3),
+        _numWorkers(0),
+        _portBudget(0),
+        _startPort(0),
+        _binaryEncoding(false)
     {
         this->setupInput(0);
         this->setupOutput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setInPlaceFraming));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getInPlaceFraming));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setCrcEnabled));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getCrcEnabled));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setCompression));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setCompressionLevel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getCompressionLevel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setPortBudget));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, getPortBudget));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Serializer, setEncoding));
     }
 
     static Block *make(void)
@@ -42,116 +248,427 @@ public:
         return new Serializer();
     }
 
+    void setInPlaceFraming(const bool inPlace)
+    {
+        _inPlaceFraming = inPlace;
+    }
+
+    bool getInPlaceFraming(void) const
+    {
+        return _inPlaceFraming;
+    }
+
+    void setCrcEnabled(const bool enabled)
+    {
+        _crcEnabled = enabled;
+    }
+
+    bool getCrcEnabled(void) const
+    {
+        return _crcEnabled;
+    }
+
+    void setMaxFrameSize(const size_t maxFrameSize)
+    {
+        if (maxFrameSize < MIN_FRAME_BYTES) throw Pothos::InvalidArgumentException(
+            "Serializer::setMaxFrameSize("+std::to_string(maxFrameSize)+")", "frame size too small");
+        _maxFrameSize = maxFrameSize;
+    }
+
+    size_t getMaxFrameSize(void) const
+    {
+        return _maxFrameSize;
+    }
+
+    void setCompression(const std::string &compression)
+    {
+        if (compression == "NONE") _compression = 0;
+        else if (compression == "LZ4") _compression = VITA_LZ4;
+        else if (compression == "ZSTD" and zstdAvailable()) _compression = VITA_ZSTD;
+        else if (compression == "ZSTD") throw Pothos::NotImplementedException("Serializer::setCompression("+compression+")", "built without zstd");
+        else throw Pothos::InvalidArgumentException("Serializer::setCompression("+compression+")", "unknown compression");
+    }
+
+    void setCompressionLevel(const int level)
+    {
+        if (zstdAvailable() and (level < zstdMinLevel() or level > zstdMaxLevel())) throw Pothos::RangeException(
+            "Serializer::setCompressionLevel("+std::to_string(level)+")", "level out of range");
+        _compressionLevel = level;
+    }
+
+    int getCompressionLevel(void) const
+    {
+        return _compressionLevel;
+    }
+
+    void setNumWorkers(const size_t numWorkers)
+    {
+        _numWorkers = numWorkers;
+        //pool was running -> restart with the new size
+        if (_workers)
+        {
+            this->deactivate();
+            this->activate();
+        }
+    }
+
+    size_t getNumWorkers(void) const
+    {
+        return _numWorkers;
+    }
+
+    void setPortBudget(const size_t budget)
+    {
+        _portBudget = budget;
+    }
+
+    size_t getPortBudget(void) const
+    {
+        return _portBudget;
+    }
+
+    void setEncoding(const std::string &encoding)
+    {
+        if (encoding == "POTHOS") _binaryEncoding = false;
+        else if (encoding == "BINARY") _binaryEncoding = true;
+        else throw Pothos::InvalidArgumentException("Serializer::setEncoding("+encoding+")", "unknown encoding");
+    }
+
     void work(void);
+    void postFrame(Pothos::OutputPort *outputPort, const size_t sid, const int flags, const unsigned long long index, const Pothos::BufferChunk &payload);
+    void postSerialized(Pothos::OutputPort *outputPort, const size_t sid, int flags, const unsigned long long tsf, const std::string &data);
 
     void activate(void)
     {
         _seqs.resize(this->inputs().size());
+        if (_numWorkers != 0) _workers.reset(new WorkerPool(_numWorkers));
+    }
+
+    void deactivate(void)
+    {
+        _workers.reset();
+    }
+
+    Pothos::BufferManager::Sptr getInputBufferManager(const std::string &name, const std::string &)
+    {
+        //replace the manager of a previous commit, so its slab is released
+        _managers.erase(name);
+        if (not _inPlaceFraming) return Pothos::BufferManager::Sptr();
+        std::shared_ptr<FramingBufferManager> manager(new FramingBufferManager());
+        _managers[name] = manager;
+        return manager;
     }
 
 private:
+    //a reasonable lower limit that leaves room for a payload
+    static const size_t MIN_FRAME_BYTES = 64;
+
+    //the largest 32-bit aligned payload that fits in a frame with all headers
+    size_t maxPayloadBytes(void) const
+    {
+        return ((_maxFrameSize - HDR_TLR_BYTES)/4)*4;
+    }
+
+    bool hasRoom(const Pothos::BufferChunk &buff) const
+    {
+        for (const auto &pair : _managers)
+        {
+            if (pair.second->hasRoom(buff)) return true;
+        }
+        return false;
+    }
+
+    bool _inPlaceFraming;
+    bool _crcEnabled;
+    size_t _maxFrameSize;
+    int _compression; //the VITA flag of the compression method or 0
+    int _compressionLevel;
+    size_t _numWorkers;
+    std::unique_ptr<WorkerPool> _workers;
+    size_t _portBudget;
+    size_t _startPort;
+    bool _binaryEncoding;
+    std::string _encoded; //reused to avoid reallocation
     std::vector<size_t> _seqs;
+    std::map<std::string, std::shared_ptr<FramingBufferManager>> _managers; //by input port name
 };
 
 static Pothos::BlockRegistry registerSerializer(
     "/blocks/serializer", &Serializer::make);
 
+/*!
+ * The number of header bytes for a frame with the given payload.
+ * Large frames have an additional extended length header word.
+ */
+static size_t headerBytes(const int flags, const size_t payloadBytes)
+{
+    const size_t hdr_words32 = (flags & VITA_TSF)? 6 : 4;
+    const size_t tlr_words32 = (flags & VITA_CRC)? 2 : 1;
+    const size_t pkt_bytes = (hdr_words32 + tlr_words32)*4 + payloadBytes;
+    return (needsExtLen(pkt_bytes)? hdr_words32+1 : hdr_words32)*4;
+}
+
+/*!
+ * Pack header fields into the start of a frame.
+ * The flags specify the optional VITA header bits.
+ * Return the number of header bytes.
+ */
+static size_t packHeader(const size_t seq, const size_t sid, int flags, const unsigned long long tsf, const size_t payloadBytes, uint32_t *p)
+{
+    const size_t hdr_words32 = headerBytes(flags, payloadBytes)/4;
+    const bool has_tsf = bool(flags & VITA_TSF);
+    const bool has_xlen = hdr_words32 != (has_tsf? 6 : 4);
+    if (has_xlen) flags |= VITA_XLEN;
+    const size_t tlr_words32 = (flags & VITA_CRC)? 2 : 1;
+    const size_t pkt_bytes = hdr_words32*4 + payloadBytes + tlr_words32*4;
+    const size_t pkt_words32 = hdr_words32 + padUp32(payloadBytes)/4 + tlr_words32;
+    const size_t vita_words32 = has_xlen? 0 : pkt_words32 - 3;
+
+    p[0] = Poco::ByteOrder::toNetwork(mVRL);
+    p[1] = Poco::ByteOrder::toNetwork(uint32_t(((seq & 0xfff) << 20) | (has_xlen? 0 : (pkt_bytes & 0xfffff))));
+    p[2] = Poco::ByteOrder::toNetwork(uint32_t(VITA_SID | flags | ((seq & 0xf) << 16) | (vita_words32 & 0xffff)));
+    p[3] = Poco::ByteOrder::toNetwork(uint32_t(sid));
+    size_t i = 4;
+    if (has_xlen) p[i++] = Poco::ByteOrder::toNetwork(uint32_t(pkt_bytes));
+    if (has_tsf) p[i++] = Poco::ByteOrder::toNetwork(uint32_t(tsf >> 32));
+    if (has_tsf) p[i++] = Poco::ByteOrder::toNetwork(uint32_t(tsf >> 0));
+    return hdr_words32*4;
+}
+
+/*!
+ * Pack the padding and trailer that follow the payload.
+ * The crc argument is the checksum of the header and payload.
+ * Return the number of trailer bytes including padding.
+ */
+static size_t packTrailer(const size_t payloadBytes, const int flags, uint32_t crc, char *p)
+{
+    const size_t padBytes = padUp32(payloadBytes) - payloadBytes;
+    std::memset(p, 0, padBytes);
+    size_t offset = padBytes;
+    if (flags & VITA_CRC)
+    {
+        crc = Poco::ByteOrder::toNetwork(crc32c(crc, p, padBytes));
+        std::memcpy(p + offset, &crc, CRC_BYTES);
+        offset += CRC_BYTES;
+    }
+    const uint32_t vend = Poco::ByteOrder::toNetwork(VEND);
+    std::memcpy(p + offset, &vend, 4);
+    return offset + 4;
+}
+
+/*!
+ * Frame a payload with a header and trailer in a separate pooled buffer.
+ */
+void Serializer::postFrame(Pothos::OutputPort *outputPort, const size_t sid, const int flags, const unsigned long long index, const Pothos::BufferChunk &payload)
+{
+    auto hdrTlrBuff = outputPort->getBuffer(HEADROOM_BYTES + TAILROOM_BYTES);
+    const size_t hdr_bytes = packHeader(_seqs[sid]++, sid, flags, index, payload.length, hdrTlrBuff);
+    uint32_t crc = 0;
+    if (flags & VITA_CRC)
+    {
+        crc = crc32c(crc, hdrTlrBuff.as<const void *>(), hdr_bytes);
+        crc = crc32c(crc, payload.as<const void *>(), payload.length);
+    }
+    const size_t tlr_bytes = packTrailer(payload.length, flags, crc, hdrTlrBuff.as<char *>() + hdr_bytes);
+
+    //post the header
+    hdrTlrBuff.length = hdr_bytes;
+    outputPort->postBuffer(hdrTlrBuff);
+
+    //post the payload
+    outputPort->postBuffer(payload);
+
+    //post the trailer
+    hdrTlrBuff.address += hdr_bytes;
+    hdrTlrBuff.length = tlr_bytes;
+    outputPort->postBuffer(std::move(hdrTlrBuff));
+}
+
 /*!
  * Pack header fields into an outgoing buffer.
+ * The buffer must have room for the header and trailer.
  */
-static void packBuffer(const size_t seq, const size_t sid, const bool has_tsf, const unsigned long long tsf, const bool is_ext, Pothos::BufferChunk &buff)
+static void packBuffer(const size_t seq, const size_t sid, const int flags, const unsigned long long tsf, Pothos::BufferChunk &buff)
 {
     assert(buff.length > 0);
-    const size_t hdr_words32 = has_tsf? 6 : 4;
-    const size_t pkt_bytes = hdr_words32*4 + buff.length + 4;
-    const size_t pkt_words32 = hdr_words32 + padUp32(buff.length)/4 + 1;
-    const size_t vita_words32 = pkt_words32 - 3;
+    const size_t hdr_bytes = headerBytes(flags, buff.length);
 
     //adjust address/length for full packet
-    assert(buff.address >= hdr_words32*4);
-    buff.address -= hdr_words32*4;
-    buff.length = pkt_words32*4;
+    assert(buff.address >= hdr_bytes);
+    const size_t payloadBytes = buff.length;
+    buff.address -= hdr_bytes;
+    packHeader(seq, sid, flags, tsf, payloadBytes, buff);
+    const uint32_t crc = (flags & VITA_CRC)? crc32c(0, buff.as<const void *>(), hdr_bytes + payloadBytes) : 0;
+    buff.length = hdr_bytes + payloadBytes + packTrailer(payloadBytes, flags, crc, buff.as<char *>() + hdr_bytes + payloadBytes);
+}
 
-    uint32_t *p = buff;
-    p[0] = Poco::ByteOrder::toNetwork(mVRL);
-    p[1] = Poco::ByteOrder::toNetwork(uint32_t(((seq << 20) & 0xfff) | (pkt_bytes & 0xfffff)));
-    p[2] = Poco::ByteOrder::toNetwork(uint32_t(VITA_SID | (is_ext? VITA_EXT : 0) | (has_tsf? VITA_TSF : 0) | ((seq << 16) & 0xf) | (vita_words32 & 0xffff)));
-    p[3] = Poco::ByteOrder::toNetwork(uint32_t(sid));
-    if (has_tsf) p[4] = Poco::ByteOrder::toNetwork(uint32_t(tsf >> 32));
-    if (has_tsf) p[5] = Poco::ByteOrder::toNetwork(uint32_t(tsf >> 0));
-    p[pkt_words32-1] = Poco::ByteOrder::toNetwork(VEND);
+/*!
+ * Compress a payload into a new buffer with room for the header and trailer.
+ * The method is the VITA flag of the compression, VITA_LZ4 or VITA_ZSTD.
+ * The compressed payload begins with the uncompressed length.
+ * Return an empty buffer when the payload does not compress.
+ */
+static Pothos::BufferChunk compressPayload(const Pothos::BufferChunk &payload, const int method, const int level)
+{
+    if (payload.length <= LZ4_HDR_BYTES) return Pothos::BufferChunk();
+    const size_t capacity = payload.length - LZ4_HDR_BYTES - 1;
+    Pothos::BufferChunk buff(HEADROOM_BYTES + LZ4_HDR_BYTES + capacity + TAILROOM_BYTES);
+    buff.address += HEADROOM_BYTES;
+    char *dst = buff.as<char *>() + LZ4_HDR_BYTES;
+    const size_t n = (method == VITA_ZSTD)?
+        zstdCompress(payload.as<const void *>(), payload.length, dst, capacity, level):
+        lz4Compress(payload.as<const void *>(), payload.length, dst, capacity);
+    if (n == 0) return Pothos::BufferChunk();
+    const uint32_t len = Poco::ByteOrder::toNetwork(uint32_t(payload.length));
+    std::memcpy(buff.as<void *>(), &len, LZ4_HDR_BYTES);
+    buff.length = LZ4_HDR_BYTES + n;
+    return buff;
 }
 
 /*!
- * Serialize an object into a buffer.
+ * Copy serialized data into a pooled buffer,
+ * offset by enough room for the frame header.
  */
-static Pothos::BufferChunk objectToOffsetBuffer(const size_t offset_words32, const Pothos::Object &obj)
+static Pothos::BufferChunk stringToOffsetBuffer(Pothos::OutputPort *outputPort, const int flags, const std::string &str)
 {
-    //serialize the object into a string
-    std::stringstream ss;
-    obj.serialize(ss);
-
-    //memcpy the stringstream into a buffer
-    Pothos::BufferChunk buff(padUp32(ss.str().length()) + HDR_TLR_BYTES); //string length + padding
-    buff.length = ss.str().length();
-    buff.address += offset_words32*4;
-    std::memcpy(buff.as<void *>(), ss.str().data(), buff.length);
+    auto buff = outputPort->getBuffer(padUp32(str.length()) + HDR_TLR_BYTES); //string length + padding
+    buff.length = str.length();
+    buff.address += headerBytes(flags, str.length());
+    std::memcpy(buff.as<void *>(), str.data(), buff.length);
     return buff;
 }
 
+/*!
+ * Frame and post serialized labels or messages.
+ */
+void Serializer::postSerialized(Pothos::OutputPort *outputPort, const size_t sid, int flags, const unsigned long long tsf, const std::string &data)
+{
+    auto buff = stringToOffsetBuffer(outputPort, flags, data);
+    if (_compression != 0)
+    {
+        auto compressed = compressPayload(buff, _compression, _compressionLevel);
+        if (compressed)
+        {
+            buff = std::move(compressed);
+            flags |= _compression;
+        }
+    }
+    packBuffer(_seqs[sid]++, sid, flags, tsf, buff);
+    outputPort->postBuffer(std::move(buff));
+}
+
 void Serializer::work(void)
 {
     auto outputPort = this->output(0);
+    const int crcFlag = _crcEnabled? VITA_CRC : 0;
+    const size_t numInputs = this->inputs().size();
+    bool hasMore = false;
 
-    for (size_t i = 0; i < this->inputs().size(); i++)
+    //rotate the first port so that no port is always served last
+    if (_startPort >= numInputs) _startPort = 0;
+    const size_t startPort = _startPort++;
+
+    for (size_t n = 0; n < numInputs; n++)
     {
+        const size_t i = (startPort + n) % numInputs;
         auto inputPort = this->input(i);
 
         //messages (async messages handled asap)
         while (inputPort->hasMessage())
         {
-            auto msg = inputPort->popMessage();
-            const size_t hdr_words32 = 4; // a priori
-            auto buff = objectToOffsetBuffer(hdr_words32, msg);
-            packBuffer(_seqs[i]++, i, false, 0, true, buff);
-            outputPort->postBuffer(std::move(buff));
+            if (_binaryEncoding)
+            {
+                BinaryEncoder encoder(_encoded);
+                encoder.encodeObject(inputPort->popMessage());
+                this->postSerialized(outputPort, i, VITA_EXT | VITA_BIN | crcFlag, 0, _encoded);
+                continue;
+            }
+            std::stringstream ss;
+            inputPort->popMessage().serialize(ss);
+            this->postSerialized(outputPort, i, VITA_EXT | crcFlag, 0, ss.str());
         }
 
         //labels (always handled prior to buffers for ordering reasons)
+        //all labels are batched into one frame with absolute indexes,
+        //and the frame's timestamp is the index of the first label
+        std::stringstream labels;
+        BinaryEncoder encoder(_encoded);
+        unsigned long long firstIndex = 0;
+        size_t numLabels = 0;
         while (inputPort->labels().begin() != inputPort->labels().end())
         {
             auto lbl = *inputPort->labels().begin();
             inputPort->removeLabel(lbl);
-            const size_t hdr_words32 = 6; // a priori
-            auto index = lbl.index + inputPort->totalElements();
-            auto buff = objectToOffsetBuffer(hdr_words32, Pothos::Object(std::move(lbl)));
-            packBuffer(_seqs[i]++, i, true, index, true, buff);
-            outputPort->postBuffer(std::move(buff));
+            lbl.index += inputPort->totalElements();
+            if (numLabels++ == 0) firstIndex = lbl.index;
+            if (_binaryEncoding) encoder.encodeLabel(lbl);
+            else Pothos::Object(std::move(lbl)).serialize(labels);
         }
+        if (numLabels != 0 and _binaryEncoding) this->postSerialized(outputPort, i, VITA_EXT | VITA_BIN | VITA_TSF | crcFlag, firstIndex, _encoded);
+        else if (numLabels != 0) this->postSerialized(outputPort, i, VITA_EXT | VITA_TSF | crcFlag, firstIndex, labels.str());
 
-        //buffers
+        //buffers (limited to the byte budget for this port)
         auto buff = inputPort->takeBuffer();
-        if (buff.length > 0)
+        if (buff.length == 0) continue;
+        const bool partial = _portBudget != 0 and buff.length > _portBudget;
+        if (partial)
+        {
+            buff.length = _portBudget;
+            hasMore = true;
+        }
+        auto index = inputPort->totalElements();
+        inputPort->consume(buff.length);
+
+        //write the header and trailer around the payload in-place
+        //(a partial buffer cannot use the tailroom, its followed by input data)
+        const size_t maxPayload = this->maxPayloadBytes();
+        if (_compression == 0 and not partial and buff.length <= maxPayload and this->hasRoom(buff))
         {
-            auto hdrTlrBuff = Pothos::BufferChunk(buff.length+HDR_TLR_BYTES);
-            const size_t hdr_words32 = 6; // a priori
-            hdrTlrBuff.address += hdr_words32*4;
-            hdrTlrBuff.length = buff.length;
-            packBuffer(_seqs[i]++, i, true, inputPort->totalElements(), false, hdrTlrBuff);
-            const size_t pkt_words32 = hdr_words32 + padUp32(buff.length)/4 + 1;
-
-            //post the header
-            hdrTlrBuff.length = hdr_words32*4;
-            outputPort->postBuffer(hdrTlrBuff);
-
-            //post the payload
-            inputPort->consume(buff.length);
+            packBuffer(_seqs[i]++, i, VITA_TSF | crcFlag, index, buff);
             outputPort->postBuffer(std::move(buff));
+            continue;
+        }
+
+        //split large buffers into multiple frames
+        std::vector<Pothos::BufferChunk> payloads;
+        while (buff.length != 0)
+        {
+            auto payload = buff;
+            payload.length = std::min(buff.length, maxPayload);
+            buff.address += payload.length;
+            buff.length -= payload.length;
+            payloads.push_back(std::move(payload));
+        }
 
-            //post the trailer
-            hdrTlrBuff.address += (pkt_words32 - 1)*4;
-            hdrTlrBuff.length = 4;
-            outputPort->postBuffer(std::move(hdrTlrBuff));
+        //compress each frame, multiple frames are compressed in parallel by the pool
+        std::vector<Pothos::BufferChunk> compressed(payloads.size());
+        if (_compression != 0)
+        {
+            const size_t numTasks = _workers? std::min(payloads.size(), _workers->size()) : 1;
+            auto compressAll = [&](const size_t first)
+            {
+                for (size_t j = first; j < payloads.size(); j += numTasks)
+                {
+                    compressed[j] = compressPayload(payloads[j], _compression, _compressionLevel);
+                }
+            };
+            if (numTasks > 1) _workers->run(numTasks, compressAll);
+            else compressAll(0);
+        }
+
+        //post the frames in order
+        for (size_t j = 0; j < payloads.size(); j++)
+        {
+            if (compressed[j])
+            {
+                packBuffer(_seqs[i]++, i, VITA_TSF | _compression | crcFlag, index, compressed[j]);
+                outputPort->postBuffer(std::move(compressed[j]));
+            }
+            else this->postFrame(outputPort, i, VITA_TSF | crcFlag, index, payloads[j]);
+            index += payloads[j].length;
         }
     }
+
+    //ports with remaining input are served in the next call
+    if (hasMore) this->yield();
 }
@@ -1,14 +1,103 @@
 // Copyright (c) 2014-2017 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "Lz4.hpp"
+#include "Zstd.hpp"
+#include "VrlIndex.hpp"
 #include <Pothos/Testing.hpp>
 #include <Pothos/Framework.hpp>
 #include <Pothos/Proxy.hpp>
+#include <Poco/TemporaryFile.h>
+#include <Poco/ByteOrder.h>
 #include <iostream>
+#include <cstring>
+#include <cstdlib> //rand
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <utility>
 #include <json.hpp>
 
 using json = nlohmann::json;
 
+/***********************************************************************
+ * Helpers for tests that inspect or modify the serialized byte stream
+ **********************************************************************/
+static Pothos::BufferChunk serializeBuffer(Pothos::Proxy serializer, const Pothos::BufferChunk &buff)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    feeder.call("feedBuffer", buff);
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    return collector.call("getBuffer");
+}
+
+//read a header word of the frame at the offset
+static uint32_t frameWord(const std::string &bytes, const size_t offset, const size_t word)
+{
+    uint32_t w = 0;
+    std::memcpy(&w, bytes.data() + offset + word*4, 4);
+    return Poco::ByteOrder::fromNetwork(w);
+}
+
+//split a serialized byte stream into its frames (without extended length)
+static std::vector<std::string> splitFrames(const Pothos::BufferChunk &buff)
+{
+    const std::string bytes(buff.as<const char *>(), buff.length);
+    std::vector<std::string> frames;
+    size_t offset = 0;
+    while (offset + 8 <= bytes.size())
+    {
+        const size_t frameBytes = ((frameWord(bytes, offset, 1) & 0xfffff) + 3) & ~size_t(3);
+        POTHOS_TEST_TRUE(frameBytes != 0);
+        frames.push_back(bytes.substr(offset, frameBytes));
+        offset += frameBytes;
+    }
+    POTHOS_TEST_EQUAL(offset, bytes.size());
+    return frames;
+}
+
+//deserialize a byte stream that is fed in buffers of up to the chunk size
+static Pothos::BufferChunk deserializeBytes(Pothos::Proxy deserializer, const std::string &bytes, const size_t chunkSize, std::vector<Pothos::Label> *labels = nullptr)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    for (size_t offset = 0; offset < bytes.size(); offset += chunkSize)
+    {
+        const size_t n = std::min(chunkSize, bytes.size() - offset);
+        Pothos::BufferChunk chunk("uint8", n);
+        std::memcpy(chunk.as<void *>(), bytes.data() + offset, n);
+        feeder.call("feedBuffer", chunk);
+    }
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    if (labels != nullptr)
+    {
+        const std::vector<Pothos::Label> collected = collector.call("getLabels");
+        *labels = collected;
+    }
+    return collector.call("getBuffer");
+}
+
+static Pothos::BufferChunk makeRamp(const size_t numBytes)
+{
+    Pothos::BufferChunk b0("uint8", numBytes);
+    for (size_t i = 0; i < b0.elements(); i++)
+        b0.as<unsigned char *>()[i] = (unsigned char)(i*7);
+    return b0;
+}
+
 POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_blocks)
 {
     auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
@@ -36,3 +125,748 @@ POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_blocks)
 
     collector.call("verifyTestPlan", expected);
 }
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_fragmented)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+
+    //chop the serialized stream into small odd-sized buffers
+    //so that frames straddle the boundaries of the input buffers
+    auto s2p = Pothos::BlockRegistry::make("/blocks/stream_to_packet");
+    auto p2s = Pothos::BlockRegistry::make("/blocks/packet_to_stream");
+    s2p.call("setMTU", 37);
+
+    //create a test plan
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableLabels"] = true;
+    testPlan["enableMessages"] = true;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, s2p, 0);
+        topology.connect(s2p, 0, p2s, 0);
+        topology.connect(p2s, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    collector.call("verifyTestPlan", expected);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_deserializer_straddling)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setMaxFrameSize", 1024);
+    const auto b0 = makeRamp(3000);
+    const auto bytes = serializeBuffer(serializer, b0);
+    const std::string stream(bytes.as<const char *>(), bytes.length);
+
+    //frames split at every byte, inside the header, and across several buffers
+    for (const size_t chunkSize : {size_t(1), size_t(5), size_t(23), size_t(1000), size_t(1031), stream.size()})
+    {
+        std::cout << "testing chunk size " << chunkSize << std::endl;
+        auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+        const auto buffer = deserializeBytes(deserializer, stream, chunkSize);
+        POTHOS_TEST_EQUAL(buffer.length, b0.length);
+        POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+        const unsigned long long resyncs = deserializer.call("getResyncCount");
+        POTHOS_TEST_EQUAL(resyncs, 0);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_in_place)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    serializer.call("setInPlaceFraming", true);
+    serializer.call("setCrcEnabled", true);
+
+    //create a test plan
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableLabels"] = true;
+    testPlan["enableMessages"] = true;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    collector.call("verifyTestPlan", expected);
+    const unsigned long long crcFailures = deserializer.call("getCrcFailures");
+    POTHOS_TEST_EQUAL(crcFailures, 0);
+}
+
+static void test_serializer_large_buffer(const size_t numBytes, const size_t maxFrameSize, const std::string &compression = "NONE", const size_t numWorkers = 0)
+{
+    std::cout << "testing " << numBytes << " bytes with max frame size " << maxFrameSize << ", compression " << compression << ", workers " << numWorkers << std::endl;
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    serializer.call("setMaxFrameSize", maxFrameSize);
+    serializer.call("setCompression", compression);
+    serializer.call("setNumWorkers", numWorkers);
+    deserializer.call("setMaxFrameSize", maxFrameSize);
+
+    Pothos::BufferChunk b0("uint8", numBytes);
+    for (size_t i = 0; i < b0.elements(); i++)
+        b0.as<unsigned char *>()[i] = (unsigned char)(i*7);
+    feeder.call("feedBuffer", b0);
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const Pothos::BufferChunk buffer = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buffer.length, b0.length);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_large_buffers)
+{
+    test_serializer_large_buffer(1000*1000, 128*1024); //split into frames
+    test_serializer_large_buffer(3*1024*1024, 4*1024*1024); //extended length frames
+    test_serializer_large_buffer(1000*1000, 128*1024, "LZ4"); //frames compressed on the calling thread
+    test_serializer_large_buffer(1000*1000, 128*1024, "LZ4", 3); //frames compressed in parallel
+}
+
+static void test_serializer_large_packet(const std::string &encoding)
+{
+    std::cout << "testing a large packet with encoding " << encoding << std::endl;
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+
+    //default frame sizes, the packet does not fit in a stream frame
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    serializer.call("setEncoding", encoding);
+
+    Pothos::Packet packet;
+    packet.payload = makeRamp(200*1024);
+    packet.metadata["key"] = Pothos::Object(std::string("value"));
+    feeder.call("feedPacket", packet);
+
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const std::vector<Pothos::Packet> packets = collector.call("getPackets");
+    POTHOS_TEST_EQUAL(packets.size(), 1);
+    POTHOS_TEST_EQUAL(packets[0].payload.length, packet.payload.length);
+    POTHOS_TEST_EQUALA(packets[0].payload.as<const unsigned char *>(), packet.payload.as<const unsigned char *>(), packet.payload.length);
+    POTHOS_TEST_EQUAL(packets[0].metadata.at("key").convert<std::string>(), "value");
+    const unsigned long long skippedBytes = deserializer.call("getSkippedBytes");
+    POTHOS_TEST_EQUAL(skippedBytes, 0);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_large_packets)
+{
+    test_serializer_large_packet("POTHOS");
+    test_serializer_large_packet("BINARY");
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_file_index)
+{
+    auto tempFile = Poco::TemporaryFile();
+    std::cout << "tempFile " << tempFile.path() << std::endl;
+    POTHOS_TEST_TRUE(tempFile.createFile());
+    Poco::TemporaryFile::registerForDeletion(tempFile.path() + ".idx");
+
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto fileSink = Pothos::BlockRegistry::make("/blocks/vrl_file_sink");
+    serializer.call("setMaxFrameSize", 1024);
+    fileSink.call("setFilePath", tempFile.path());
+
+    //two separate buffers so the label frame is recorded between them
+    Pothos::BufferChunk b0("uint8", 100000);
+    for (size_t i = 0; i < b0.elements(); i++)
+        b0.as<unsigned char *>()[i] = (unsigned char)(i*7);
+    Pothos::BufferChunk b1("uint8", 50000);
+    Pothos::BufferChunk b2("uint8", 50000);
+    std::memcpy(b1.as<void *>(), b0.as<const char *>(), b1.length);
+    std::memcpy(b2.as<void *>(), b0.as<const char *>() + b1.length, b2.length);
+    feeder.call("feedBuffer", b1);
+    feeder.call("feedBuffer", b2);
+    feeder.call("feedLabel", Pothos::Label("mark", 42, 75000));
+
+    //record the serialized stream and the index
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, fileSink, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    const unsigned long long numFrames = fileSink.call("getNumFrames");
+    POTHOS_TEST_TRUE(numFrames > 100);
+
+    //seek to an index in the middle of the recording
+    auto fileSource = Pothos::BlockRegistry::make("/blocks/vrl_file_source");
+    fileSource.call("setFilePath", tempFile.path());
+    const unsigned long long numIndexed = fileSource.call("getNumFrames");
+    POTHOS_TEST_EQUAL(numIndexed, numFrames);
+    const unsigned long long start = fileSource.call("seekToIndex", 0, 30000);
+    POTHOS_TEST_TRUE(start <= 30000);
+    POTHOS_TEST_TRUE(start + 1024 > 30000);
+
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    {
+        Pothos::Topology topology;
+        topology.connect(fileSource, 0, deserializer, 0);
+        topology.connect(deserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const Pothos::BufferChunk buffer = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buffer.length, b0.length - start);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>() + start, buffer.length);
+
+    //the second buffer has a label, so playback begins at its first frame
+    auto splitSource = Pothos::BlockRegistry::make("/blocks/vrl_file_source");
+    splitSource.call("setFilePath", tempFile.path());
+    const unsigned long long splitStart = splitSource.call("seekToIndex", 0, 60000);
+    POTHOS_TEST_EQUAL(splitStart, b1.length);
+    auto splitDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    auto splitCollector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    {
+        Pothos::Topology topology;
+        topology.connect(splitSource, 0, splitDeserializer, 0);
+        topology.connect(splitDeserializer, 0, splitCollector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    const Pothos::BufferChunk splitBuffer = splitCollector.call("getBuffer");
+    POTHOS_TEST_EQUAL(splitBuffer.length, b2.length);
+    const std::vector<Pothos::Label> splitLabels = splitCollector.call("getLabels");
+    POTHOS_TEST_EQUAL(splitLabels.size(), 1);
+    POTHOS_TEST_EQUAL(splitLabels[0].index, 25000);
+
+    //seek to the label, the sidecar is read again from the file
+    auto labelSource = Pothos::BlockRegistry::make("/blocks/vrl_file_source");
+    labelSource.call("setFilePath", tempFile.path());
+    const unsigned long long labelIndex = labelSource.call("seekToLabel", 0, "mark", 0);
+    POTHOS_TEST_EQUAL(labelIndex, 75000);
+
+    //the label is located by the first stream frame after the seek
+    auto labelDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    auto labelCollector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    {
+        Pothos::Topology topology;
+        topology.connect(labelSource, 0, labelDeserializer, 0);
+        topology.connect(labelDeserializer, 0, labelCollector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const Pothos::BufferChunk labelBuffer = labelCollector.call("getBuffer");
+    POTHOS_TEST_EQUAL(labelBuffer.length, b2.length);
+    const std::vector<Pothos::Label> labels = labelCollector.call("getLabels");
+    POTHOS_TEST_EQUAL(labels.size(), 1);
+    POTHOS_TEST_EQUAL(labels[0].id, "mark");
+    POTHOS_TEST_EQUAL(labels[0].index, 25000);
+
+    //joining a recording part way through is not a loss
+    const unsigned long long droppedFrames = labelDeserializer.call("getDroppedFrames");
+    POTHOS_TEST_EQUAL(droppedFrames, 0);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_vrl_index_resync)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setMaxFrameSize", 1024);
+    const auto bytes = serializeBuffer(serializer, makeRamp(3000));
+    const auto frames = splitFrames(bytes);
+
+    //a false header claims a frame that is too large to be real,
+    //and a false header whose frame span covers the first real frame
+    auto falseHeader = [](const uint32_t pktBytes)
+    {
+        const uint32_t words[4] = {
+            Poco::ByteOrder::toNetwork(mVRL),
+            Poco::ByteOrder::toNetwork(pktBytes),
+            Poco::ByteOrder::toNetwork(uint32_t(VITA_SID | ((pktBytes+3)/4 - 3))),
+            0};
+        return std::string(reinterpret_cast<const char *>(words), sizeof(words));
+    };
+    const std::string junk = falseHeader(0xfffff) + falseHeader(200);
+    const std::string stream = junk + std::string(bytes.as<const char *>(), bytes.length);
+
+    //the builder finds every real frame, fed at once or in small chunks
+    for (const size_t chunkSize : {size_t(7), stream.size()})
+    {
+        VrlIndexBuilder builder;
+        for (size_t offset = 0; offset < stream.size(); offset += chunkSize)
+        {
+            builder.feed(stream.data() + offset, std::min(chunkSize, stream.size() - offset));
+        }
+        const auto &index = builder.index();
+        POTHOS_TEST_EQUAL(index.recordingBytes, stream.size());
+        POTHOS_TEST_EQUAL(index.entries.size(), frames.size());
+        unsigned long long offset = junk.size();
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            POTHOS_TEST_EQUAL(index.entries[i].offset, offset);
+            POTHOS_TEST_EQUAL(index.entries[i].frameBytes, frames[i].size());
+            offset += frames[i].size();
+        }
+    }
+}
+
+static void test_deserializer_resync(const size_t chunkSize)
+{
+    std::cout << "testing resync with chunk size " << chunkSize << std::endl;
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setMaxFrameSize", 1024);
+    const auto b0 = makeRamp(3000);
+    const auto frames = splitFrames(serializeBuffer(serializer, b0));
+    POTHOS_TEST_TRUE(frames.size() >= 3);
+
+    //junk with partial matches of the magic word, and false frames that
+    //claim a size that is too small, too large, or that lack the VEND trailer
+    std::string junk;
+    junk += std::string(13, '\xaa') + "mVR" + std::string(7, 'm') + "mV";
+    junk += std::string("mVRL\x00\x00\x00\x04", 8); //too small
+    junk += std::string("mVRL\x00\x0f\xff\xff", 8); //too large
+    junk += std::string(5, '\xaa') + std::string("mVRL\x00\x00\x00\x40", 8) + std::string(61, '\xaa'); //no trailer
+
+    //junk before the first frame and between frames, at unaligned offsets
+    std::string bytes = junk;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        bytes += frames[i];
+        if (i == 0) bytes += junk.substr(0, junk.size()-1);
+    }
+
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    const auto buffer = deserializeBytes(deserializer, bytes, chunkSize);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+
+    const unsigned long long resyncCount = deserializer.call("getResyncCount");
+    const unsigned long long skippedBytes = deserializer.call("getSkippedBytes");
+    const unsigned long long droppedFrames = deserializer.call("getDroppedFrames");
+    POTHOS_TEST_EQUAL(resyncCount, 2);
+    POTHOS_TEST_EQUAL(skippedBytes, junk.size()*2-1);
+    POTHOS_TEST_EQUAL(droppedFrames, 0);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_deserializer_resync)
+{
+    test_deserializer_resync(1024*1024); //one input buffer
+    test_deserializer_resync(37); //junk and frames straddle input buffers
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_crc)
+{
+    //checksums are computed across the separate header, payload, and trailer
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setCrcEnabled", true);
+    serializer.call("setMaxFrameSize", 1024);
+    const auto b0 = makeRamp(3000);
+    const auto frames = splitFrames(serializeBuffer(serializer, b0));
+    POTHOS_TEST_TRUE(frames.size() >= 3);
+    std::string bytes;
+    for (const auto &frame : frames)
+    {
+        POTHOS_TEST_TRUE((frameWord(frame, 0, 2) & (1 << 26)) != 0);
+        bytes += frame;
+    }
+
+    //frames that straddle input buffers are verified
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    const auto buffer = deserializeBytes(deserializer, bytes, 37);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+    const unsigned long long crcFailures = deserializer.call("getCrcFailures");
+    POTHOS_TEST_EQUAL(crcFailures, 0);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_crc_corrupt)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setCrcEnabled", true);
+    serializer.call("setMaxFrameSize", 1024);
+    const auto b0 = makeRamp(3000);
+    auto frames = splitFrames(serializeBuffer(serializer, b0));
+    POTHOS_TEST_TRUE(frames.size() >= 3);
+
+    //corrupt one payload byte of the second frame (6 header words with the timestamp)
+    const size_t hdrBytes = 24, tlrBytes = 8;
+    const size_t firstLength = (frameWord(frames[0], 0, 1) & 0xfffff) - hdrBytes - tlrBytes;
+    const size_t corruptLength = (frameWord(frames[1], 0, 1) & 0xfffff) - hdrBytes - tlrBytes;
+    frames[1][hdrBytes + 5] ^= 0x1;
+    std::string bytes;
+    for (const auto &frame : frames) bytes += frame;
+
+    //the corrupt frame is dropped, and the next frame still decodes
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    std::vector<Pothos::Label> labels;
+    const auto buffer = deserializeBytes(deserializer, bytes, bytes.size(), &labels);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length - corruptLength);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), firstLength);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>() + firstLength,
+        b0.as<const unsigned char *>() + firstLength + corruptLength, buffer.length - firstLength);
+    const unsigned long long crcFailures = deserializer.call("getCrcFailures");
+    POTHOS_TEST_EQUAL(crcFailures, 1);
+
+    //the dropped frame is reported as a loss where it was removed
+    const unsigned long long droppedFrames = deserializer.call("getDroppedFrames");
+    POTHOS_TEST_EQUAL(droppedFrames, 1);
+    POTHOS_TEST_EQUAL(labels.size(), 1);
+    POTHOS_TEST_EQUAL(labels[0].id, "drop");
+    POTHOS_TEST_EQUAL(labels[0].index, firstLength);
+
+    //in flag mode, the corrupt payload is posted with a label
+    auto flagDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    flagDeserializer.call("setCrcMode", "FLAG");
+    const auto flagged = deserializeBytes(flagDeserializer, bytes, bytes.size(), &labels);
+    POTHOS_TEST_EQUAL(flagged.length, b0.length);
+    POTHOS_TEST_EQUAL(labels.size(), 1);
+    POTHOS_TEST_EQUAL(labels[0].id, "crcError");
+    POTHOS_TEST_EQUAL(labels[0].index, firstLength);
+    const unsigned long long flagFailures = flagDeserializer.call("getCrcFailures");
+    POTHOS_TEST_EQUAL(flagFailures, 1);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_deserializer_dropped_frame)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setMaxFrameSize", 1024);
+    const auto b0 = makeRamp(3000);
+    auto frames = splitFrames(serializeBuffer(serializer, b0));
+    POTHOS_TEST_TRUE(frames.size() >= 3);
+
+    //the 12-bit sequence in the mVRL header increments per frame,
+    //and its low 4 bits match the sequence in the VITA header
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const size_t seq12 = frameWord(frames[i], 0, 1) >> 20;
+        const size_t seq4 = (frameWord(frames[i], 0, 2) >> 16) & 0xf;
+        POTHOS_TEST_EQUAL(seq12, i);
+        POTHOS_TEST_EQUAL(seq12 & 0xf, seq4);
+    }
+
+    //remove the second frame from the stream (6 header words with the timestamp)
+    const size_t hdrBytes = 24, tlrBytes = 4;
+    const size_t firstLength = (frameWord(frames[0], 0, 1) & 0xfffff) - hdrBytes - tlrBytes;
+    const size_t removedLength = (frameWord(frames[1], 0, 1) & 0xfffff) - hdrBytes - tlrBytes;
+    frames.erase(frames.begin() + 1);
+    std::string bytes;
+    for (const auto &frame : frames) bytes += frame;
+
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    std::vector<Pothos::Label> labels;
+    const auto buffer = deserializeBytes(deserializer, bytes, bytes.size(), &labels);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length - removedLength);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>() + firstLength,
+        b0.as<const unsigned char *>() + firstLength + removedLength, buffer.length - firstLength);
+
+    //the loss is counted and labeled where the frame was removed
+    const unsigned long long droppedFrames = deserializer.call("getDroppedFrames");
+    POTHOS_TEST_EQUAL(droppedFrames, 1);
+    const unsigned long long lostElements = deserializer.call("getLostElements");
+    POTHOS_TEST_EQUAL(lostElements, removedLength);
+    POTHOS_TEST_EQUAL(labels.size(), 1);
+    POTHOS_TEST_EQUAL(labels[0].id, "drop");
+    POTHOS_TEST_EQUAL(labels[0].index, firstLength);
+    POTHOS_TEST_EQUAL(labels[0].data.convert<unsigned long long>(), 1);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_compression)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setCompression", "LZ4");
+    serializer.call("setMaxFrameSize", 1024);
+
+    //a repeating ramp compresses, every frame has the LZ4 flag
+    const auto b0 = makeRamp(3000);
+    const auto bytes = serializeBuffer(serializer, b0);
+    POTHOS_TEST_TRUE(bytes.length < b0.length);
+    std::string stream;
+    for (const auto &frame : splitFrames(bytes))
+    {
+        POTHOS_TEST_TRUE((frameWord(frame, 0, 2) & (1 << 23)) != 0);
+        stream += frame;
+    }
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    const auto buffer = deserializeBytes(deserializer, stream, 37);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+
+    //random data does not compress, the frames are sent uncompressed
+    Pothos::BufferChunk b1("uint8", 3000);
+    for (size_t i = 0; i < b1.elements(); i++) b1.as<unsigned char *>()[i] = (unsigned char)(std::rand());
+    std::string rawStream;
+    for (const auto &frame : splitFrames(serializeBuffer(serializer, b1)))
+    {
+        POTHOS_TEST_TRUE((frameWord(frame, 0, 2) & (1 << 23)) == 0);
+        rawStream += frame;
+    }
+    auto rawDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    const auto rawBuffer = deserializeBytes(rawDeserializer, rawStream, rawStream.size());
+    POTHOS_TEST_EQUAL(rawBuffer.length, b1.length);
+    POTHOS_TEST_EQUALA(rawBuffer.as<const unsigned char *>(), b1.as<const unsigned char *>(), b1.length);
+
+    //labels and messages are compressed as well
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto planDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableLabels"] = true;
+    testPlan["enableMessages"] = true;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, planDeserializer, 0);
+        topology.connect(planDeserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    collector.call("verifyTestPlan", expected);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_zstd)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    if (not zstdAvailable())
+    {
+        std::cout << "built without zstd" << std::endl;
+        POTHOS_TEST_THROWS(serializer.call("setCompression", "ZSTD"), Pothos::Exception);
+        return;
+    }
+    serializer.call("setCompression", "ZSTD");
+    serializer.call("setCompressionLevel", 19);
+    serializer.call("setMaxFrameSize", 1024);
+    POTHOS_TEST_THROWS(serializer.call("setCompressionLevel", zstdMaxLevel()+1), Pothos::Exception);
+
+    //a repeating ramp compresses, every frame has the zstd flag and not the LZ4 flag
+    const auto b0 = makeRamp(3000);
+    const auto bytes = serializeBuffer(serializer, b0);
+    POTHOS_TEST_TRUE(bytes.length < b0.length);
+    std::string stream;
+    for (const auto &frame : splitFrames(bytes))
+    {
+        POTHOS_TEST_TRUE((frameWord(frame, 0, 2) & (1 << 24)) != 0);
+        POTHOS_TEST_TRUE((frameWord(frame, 0, 2) & (1 << 23)) == 0);
+        stream += frame;
+    }
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    const auto buffer = deserializeBytes(deserializer, stream, 37);
+    POTHOS_TEST_EQUAL(buffer.length, b0.length);
+    POTHOS_TEST_EQUALA(buffer.as<const unsigned char *>(), b0.as<const unsigned char *>(), b0.length);
+
+    //labels and messages are compressed as well
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto planDeserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableLabels"] = true;
+    testPlan["enableMessages"] = true;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, serializer, 0);
+        topology.connect(serializer, 0, planDeserializer, 0);
+        topology.connect(planDeserializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+    collector.call("verifyTestPlan", expected);
+
+    //truncated and corrupt frames are rejected
+    std::vector<char> compressed(zstdCompressBound(b0.length));
+    const size_t n = zstdCompress(b0.as<const void *>(), b0.length, compressed.data(), compressed.size(), 3);
+    POTHOS_TEST_TRUE(n != 0);
+    std::vector<char> output(b0.length);
+    POTHOS_TEST_TRUE(zstdDecompress(compressed.data(), n, output.data(), output.size()));
+    POTHOS_TEST_EQUALA(output.data(), b0.as<const char *>(), b0.length);
+    POTHOS_TEST_TRUE(not zstdDecompress(compressed.data(), n-1, output.data(), output.size()));
+    POTHOS_TEST_TRUE(not zstdDecompress(compressed.data(), n, output.data(), output.size()-1));
+    compressed[0] ^= 0x55; //the frame magic number
+    POTHOS_TEST_TRUE(not zstdDecompress(compressed.data(), n, output.data(), output.size()));
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_lz4_decoder)
+{
+    //runs of repeated bytes and random literals
+    std::vector<char> input(10000);
+    for (size_t i = 0; i < input.size(); i++) input[i] = char(((i % 300) < 200)? i/300 : std::rand());
+    std::vector<char> compressed(lz4CompressBound(input.size()));
+    const size_t n = lz4Compress(input.data(), input.size(), compressed.data(), compressed.size());
+    POTHOS_TEST_TRUE(n != 0);
+    POTHOS_TEST_TRUE(n < input.size());
+    compressed.resize(n);
+
+    //guard bytes after the output detect writes out of bounds
+    const size_t guardBytes = 64;
+    std::vector<char> output(input.size() + guardBytes, 'G');
+    const auto guardOk = [&](void){return std::all_of(output.begin() + input.size(), output.end(), [](const char c){return c == 'G';});};
+    POTHOS_TEST_TRUE(lz4Decompress(compressed.data(), n, output.data(), input.size()));
+    POTHOS_TEST_EQUALA(output.data(), input.data(), input.size());
+
+    //the output size must match exactly
+    POTHOS_TEST_TRUE(not lz4Decompress(compressed.data(), n, output.data(), input.size()-1));
+    POTHOS_TEST_TRUE(not lz4Decompress(compressed.data(), n, output.data(), input.size()+1));
+    std::fill(output.begin() + input.size(), output.end(), 'G');
+
+    //truncated input never decompresses
+    size_t numTruncated = 0;
+    for (size_t len = 0; len < n; len++)
+    {
+        if (not lz4Decompress(compressed.data(), len, output.data(), input.size())) numTruncated++;
+    }
+    POTHOS_TEST_EQUAL(numTruncated, n);
+    POTHOS_TEST_TRUE(guardOk());
+
+    //corrupt input stays within the bounds of the output
+    for (size_t i = 0; i < n; i++)
+    {
+        auto corrupt = compressed;
+        corrupt[i] ^= char(0xff);
+        lz4Decompress(corrupt.data(), n, output.data(), input.size());
+    }
+    POTHOS_TEST_TRUE(guardOk());
+
+    //malformed sequences: zero offset, offset before the output, and overlong lengths
+    const char zeroOffset[] = {'\x14', 'a', '\x00', '\x00', '\x00'};
+    const char farOffset[] = {'\x10', 'a', '\x05', '\x00', '\x00'};
+    const char longLiterals[] = {'\xf0', '\xff', '\xff'};
+    const char longMatch[] = {'\x1f', 'a', '\x01', '\x00', '\xff', '\xff'};
+    POTHOS_TEST_TRUE(not lz4Decompress(zeroOffset, sizeof(zeroOffset), output.data(), 16));
+    POTHOS_TEST_TRUE(not lz4Decompress(farOffset, sizeof(farOffset), output.data(), 16));
+    POTHOS_TEST_TRUE(not lz4Decompress(longLiterals, sizeof(longLiterals), output.data(), 16));
+    POTHOS_TEST_TRUE(not lz4Decompress(longMatch, sizeof(longMatch), output.data(), 16));
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_port_budget)
+{
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    serializer.call("setPortBudget", 100);
+
+    //a busy port and a quiet port share the serializer
+    auto feeder0 = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto feeder1 = Pothos::BlockRegistry::make("/blocks/feeder_source", "uint8");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+    feeder0.call("feedBuffer", makeRamp(5000));
+    feeder1.call("feedBuffer", makeRamp(500));
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder0, 0, serializer, 0);
+        topology.connect(feeder1, 0, serializer, 1);
+        topology.connect(serializer, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //each frame is within the budget and continues the stream of its port,
+    //all bytes arrive because the serializer yields until the input is drained
+    std::vector<size_t> sids;
+    size_t totals[2] = {0, 0};
+    for (const auto &frame : splitFrames(collector.call("getBuffer")))
+    {
+        const size_t sid = frameWord(frame, 0, 3);
+        const size_t payloadBytes = (frameWord(frame, 0, 1) & 0xfffff) - 7*4;
+        POTHOS_TEST_TRUE(sid < 2);
+        POTHOS_TEST_TRUE(payloadBytes <= 100);
+        POTHOS_TEST_EQUAL(frameWord(frame, 0, 5), totals[sid]);
+        totals[sid] += payloadBytes;
+        sids.push_back(sid);
+    }
+    POTHOS_TEST_EQUAL(totals[0], 5000);
+    POTHOS_TEST_EQUAL(totals[1], 500);
+
+    //while the quiet port has data, the busy port gets at most
+    //two frames in a row (the start port rotates every work call)
+    const auto first1 = std::find(sids.begin(), sids.end(), 1);
+    const auto last1 = std::find(sids.rbegin(), sids.rend(), 1).base();
+    size_t run0 = 0;
+    for (auto it = first1; it != last1; ++it)
+    {
+        run0 = (*it == 0)? run0 + 1 : 0;
+        POTHOS_TEST_TRUE(run0 <= 2);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_serializer_binary_encoding)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    auto bytesCollector = Pothos::BlockRegistry::make("/blocks/collector_sink", "uint8");
+
+    auto serializer = Pothos::BlockRegistry::make("/blocks/serializer");
+    auto deserializer = Pothos::BlockRegistry::make("/blocks/deserializer");
+    serializer.call("setEncoding", "BINARY");
+
+    //the serialized stream is also collected
+    Pothos::Topology topology;
+    topology.connect(feeder, 0, serializer, 0);
+    topology.connect(serializer, 0, deserializer, 0);
+    topology.connect(serializer, 0, bytesCollector, 0);
+    topology.connect(deserializer, 0, collector, 0);
+
+    //test buffers with labels and messages
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableLabels"] = true;
+    testPlan["enableMessages"] = true;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    collector.call("verifyTestPlan", expected);
+
+    //test packets with labels and messages
+    testPlan["enablePackets"] = true;
+    testPlan["enableBuffers"] = false;
+    expected = feeder.call("feedTestPlan", testPlan.dump());
+    topology.commit();
+    POTHOS_TEST_TRUE(topology.waitInactive());
+    collector.call("verifyTestPlan", expected);
+
+    //every label and message frame uses the binary encoding
+    size_t numExtFrames = 0;
+    for (const auto &frame : splitFrames(bytesCollector.call("getBuffer")))
+    {
+        const uint32_t vh = frameWord(frame, 0, 2);
+        if ((vh & (1 << 29)) == 0) continue;
+        POTHOS_TEST_TRUE((vh & (1 << 22)) != 0);
+        numExtFrames++;
+    }
+    POTHOS_TEST_TRUE(numExtFrames != 0);
+}
@@ -0,0 +1,157 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "VrlIndex.hpp"
+#include <Pothos/Framework.hpp>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif //_MSC_VER
+#include <stdio.h>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#ifdef _MSC_VER
+#define MY_S_IREADWRITE _S_IREAD | _S_IWRITE
+#else
+#define MY_S_IREADWRITE S_IRUSR | S_IWUSR
+#endif
+
+#include <Poco/Logger.h>
+
+/***********************************************************************
+ * |PothosDoc VRL File Sink
+ *
+ * Record a mVRL byte stream from a serializer to a file,
+ * and write an index of the recording to a sidecar file.
+ * The index records the offset, stream ID, and stream index of each frame,
+ * so that the VRL file source can seek within the recording.
+ * The index is written to the file path with an ".idx" suffix
+ * when the block is deactivated.
+ *
+ * |category /Serialize
+ * |category /File IO
+ * |keywords sink file VRL index record
+ *
+ * |param path[File Path] The path to the output file.
+ * |default ""
+ * |widget FileEntry(mode=save)
+ *
+ * |param maxFrameSize[Max Frame Size] The maximum size of a frame in bytes.
+ * Frames that claim to be larger are not indexed.
+ * This must be at least as large as the serializer's max frame size.
+ * |default 131072
+ * |units bytes
+ * |preview valid
+ *
+ * |factory /blocks/vrl_file_sink()
+ * |setter setFilePath(path)
+ * |setter setMaxFrameSize(maxFrameSize)
+ **********************************************************************/
+class VrlFileSink : public Pothos::Block
+{
+public:
+    static Block *make(void)
+    {
+        return new VrlFileSink();
+    }
+
+    VrlFileSink(void):
+        _fd(-1),
+        _maxFrameSize(MAX_PKT_BYTES)
+    {
+        this->setupInput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSink, setFilePath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSink, setMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSink, getMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSink, getNumFrames));
+        this->registerProbe("getNumFrames", "probeNumFrames", "numFramesTriggered");
+    }
+
+    void setFilePath(const std::string &path)
+    {
+        _path = path;
+        //file was open -> close old fd, and open this new path
+        if (_fd != -1)
+        {
+            this->deactivate();
+            this->activate();
+        }
+    }
+
+    void setMaxFrameSize(const size_t maxFrameSize)
+    {
+        _maxFrameSize = maxFrameSize;
+    }
+
+    size_t getMaxFrameSize(void) const
+    {
+        return _maxFrameSize;
+    }
+
+    unsigned long long getNumFrames(void) const
+    {
+        return _builder? _builder->index().entries.size() : 0;
+    }
+
+    void activate(void)
+    {
+        if (_path.empty()) throw Pothos::FileException("VrlFileSink", "empty file path");
+        _fd = open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, MY_S_IREADWRITE);
+        if (_fd < 0)
+        {
+            poco_error_f4(Poco::Logger::get("VrlFileSink"), "open(%s) returned %d -- %s(%d)", _path, _fd, std::string(strerror(errno)), errno);
+        }
+        _builder.reset(new VrlIndexBuilder(_maxFrameSize));
+    }
+
+    void deactivate(void)
+    {
+        close(_fd);
+        _fd = -1;
+        try
+        {
+            saveVrlIndex(vrlIndexPath(_path), _builder->index());
+        }
+        catch (const Pothos::Exception &ex)
+        {
+            poco_error(Poco::Logger::get("VrlFileSink"), ex.displayText());
+        }
+    }
+
+    void work(void)
+    {
+        auto in0 = this->input(0);
+        if (in0->elements() == 0) return;
+        const void *ptr = in0->buffer();
+        auto r = write(_fd, ptr, in0->elements());
+        if (r >= 0)
+        {
+            _builder->feed(ptr, size_t(r));
+            in0->consume(size_t(r));
+        }
+        else
+        {
+            poco_error_f3(Poco::Logger::get("VrlFileSink"), "write() returned %d -- %s(%d)", int(r), std::string(strerror(errno)), errno);
+        }
+    }
+
+private:
+    int _fd;
+    std::string _path;
+    size_t _maxFrameSize;
+    std::unique_ptr<VrlIndexBuilder> _builder;
+};
+
+static Pothos::BlockRegistry registerVrlFileSink(
+    "/blocks/vrl_file_sink", &VrlFileSink::make);
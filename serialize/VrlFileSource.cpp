@@ -0,0 +1,281 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "VrlIndex.hpp"
+#include <Pothos/Framework.hpp>
+#include <Poco/Format.h>
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif //_MSC_VER
+#include <stdio.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <algorithm> //upper_bound
+#include <map>
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include <Poco/Logger.h>
+
+/***********************************************************************
+ * |PothosDoc VRL File Source
+ *
+ * Play back a mVRL recording from a file as a byte stream on port 0.
+ * Connect the output to a deserializer to restore the recorded streams,
+ * labels, and messages.
+ *
+ * <h2>Seeking</h2>
+ *
+ * The source uses the index sidecar of the recording (the file path with an ".idx" suffix)
+ * to seek directly to a frame without reading the preceding frames.
+ * When the sidecar is missing or does not cover the entire recording,
+ * the index is rebuilt by scanning the frame headers and the sidecar is rewritten.
+ *
+ * The seekToIndex(sid, index) call starts playback at the frame
+ * that contains the given index of the stream with the given stream ID.
+ * The seekToLabel(sid, id, fromIndex) call starts playback at the frame that contains
+ * the first label with the given ID at or after the given stream index.
+ * Both seek calls use a binary search over the index and return
+ * the stream index where the playback begins or the index of the label.
+ * Playback always begins on a frame boundary.
+ * When the frame is part of a larger buffer that was split into several frames,
+ * playback begins with the labels ahead of the first frame of the buffer.
+ *
+ * |category /Serialize
+ * |category /File IO
+ * |keywords source file VRL index seek replay
+ *
+ * |param path[File Path] The path to the input file.
+ * |default ""
+ * |widget FileEntry(mode=open)
+ *
+ * |param maxFrameSize[Max Frame Size] The maximum size of a frame in bytes.
+ * Frames that claim to be larger are not indexed.
+ * This must be at least as large as the serializer's max frame size.
+ * |default 131072
+ * |units bytes
+ * |preview valid
+ *
+ * |factory /blocks/vrl_file_source()
+ * |setter setFilePath(path)
+ * |setter setMaxFrameSize(maxFrameSize)
+ **********************************************************************/
+class VrlFileSource : public Pothos::Block
+{
+public:
+    static Block *make(void)
+    {
+        return new VrlFileSource();
+    }
+
+    VrlFileSource(void):
+        _fd(-1),
+        _indexLoaded(false),
+        _startOffset(0),
+        _maxFrameSize(MAX_PKT_BYTES)
+    {
+        this->setupOutput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, setFilePath));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, setMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, getMaxFrameSize));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, seekToIndex));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, seekToLabel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(VrlFileSource, getNumFrames));
+    }
+
+    void setFilePath(const std::string &path)
+    {
+        _path = path;
+        _indexLoaded = false;
+        _startOffset = 0;
+        //file was open -> close old fd, and open this new path
+        if (_fd != -1)
+        {
+            this->deactivate();
+            this->activate();
+        }
+    }
+
+    void setMaxFrameSize(const size_t maxFrameSize)
+    {
+        _maxFrameSize = maxFrameSize;
+    }
+
+    size_t getMaxFrameSize(void) const
+    {
+        return _maxFrameSize;
+    }
+
+    unsigned long long getNumFrames(void)
+    {
+        this->loadIndex();
+        return _index.entries.size();
+    }
+
+    unsigned long long seekToIndex(const size_t sid, const unsigned long long index)
+    {
+        this->loadIndex();
+        const auto &frames = _streamFrames[sid];
+        if (frames.empty()) throw Pothos::RangeException("VrlFileSource::seekToIndex()",
+            Poco::format("no stream frames for SID %z", sid));
+
+        //find the last frame that starts at or before the index
+        auto it = std::upper_bound(frames.begin(), frames.end(), index,
+            [this](const unsigned long long i, const size_t pos){return i < _index.entries[pos].index;});
+        if (it != frames.begin()) --it;
+        const auto &entry = _index.entries[*it];
+        if (it+1 == frames.end() and index >= entry.index + entry.length) throw Pothos::RangeException(
+            "VrlFileSource::seekToIndex("+std::to_string(index)+")", "index is past the end of the recording");
+
+        //a large buffer is split into consecutive frames that follow its labels,
+        //so playback begins at the first frame when the buffer has labels
+        size_t first = *it;
+        while (first != 0 and this->isFragment(_index.entries[first-1], _index.entries[first])) first--;
+        size_t pos = *it;
+        if (first != 0 and _index.entries[first-1].sid == sid and _index.entries[first-1].isLabels()) pos = first;
+
+        //include the labels that were serialized ahead of the frame
+        const auto startIndex = _index.entries[pos].index;
+        while (pos != 0 and _index.entries[pos-1].sid == sid and
+            _index.entries[pos-1].isLabels() and _index.entries[pos-1].index >= startIndex) pos--;
+
+        this->seekOffset(_index.entries[pos].offset);
+        return startIndex;
+    }
+
+    unsigned long long seekToLabel(const size_t sid, const std::string &id, const unsigned long long fromIndex)
+    {
+        this->loadIndex();
+        const auto &frames = _labelFrames[sid];
+
+        //the last frame that starts before the index may contain the label
+        auto it = std::upper_bound(frames.begin(), frames.end(), fromIndex,
+            [this](const unsigned long long i, const size_t pos){return i < _index.entries[pos].index;});
+        if (it != frames.begin()) --it;
+
+        std::ifstream file(_path.c_str(), std::ios::binary);
+        for (; it != frames.end(); ++it)
+        {
+            const auto &entry = _index.entries[*it];
+            std::vector<char> frame(entry.frameBytes);
+            file.seekg(std::streamoff(entry.offset));
+            if (not file.read(frame.data(), frame.size())) break;
+            for (const auto &label : decodeLabelFrame(frame.data(), frame.size()))
+            {
+                if (label.index < fromIndex or label.id != id) continue;
+                this->seekOffset(entry.offset);
+                return label.index;
+            }
+        }
+        throw Pothos::NotFoundException("VrlFileSource::seekToLabel("+id+")", "label not found");
+    }
+
+    void activate(void)
+    {
+        if (_path.empty()) throw Pothos::FileException("VrlFileSource", "empty file path");
+        _fd = open(_path.c_str(), O_RDONLY | O_BINARY);
+        if (_fd < 0)
+        {
+            poco_error_f4(Poco::Logger::get("VrlFileSource"), "open(%s) returned %d -- %s(%d)", _path, _fd, std::string(strerror(errno)), errno);
+        }
+        else lseek(_fd, off_t(_startOffset), SEEK_SET);
+    }
+
+    void deactivate(void)
+    {
+        close(_fd);
+        _fd = -1;
+    }
+
+    void work(void)
+    {
+        auto out0 = this->output(0);
+        void *ptr = out0->buffer();
+        auto r = read(_fd, ptr, out0->buffer().length);
+        if (r >= 0) out0->produce(size_t(r));
+        else
+        {
+            poco_error_f3(Poco::Logger::get("VrlFileSource"), "read() returned %d -- %s(%d)", int(r), std::string(strerror(errno)), errno);
+        }
+    }
+
+private:
+
+    //the previous frame holds the preceding full-size part of the same buffer
+    static bool isFragment(const VrlIndexEntry &prev, const VrlIndexEntry &entry)
+    {
+        return prev.isStream() and prev.sid == entry.sid and
+            prev.index + prev.length == entry.index and prev.length >= entry.length;
+    }
+
+    //playback resumes from this offset when the block is activated again
+    void seekOffset(const unsigned long long offset)
+    {
+        _startOffset = offset;
+        if (_fd != -1) lseek(_fd, off_t(offset), SEEK_SET);
+    }
+
+    void loadIndex(void)
+    {
+        if (_indexLoaded) return;
+        if (_path.empty()) throw Pothos::FileException("VrlFileSource", "empty file path");
+
+        std::ifstream file(_path.c_str(), std::ios::binary | std::ios::ate);
+        if (not file) throw Pothos::FileException("VrlFileSource", "cannot open " + _path);
+        const unsigned long long fileBytes = file.tellg();
+
+        //rebuild the index when it is missing or out of date
+        const auto indexPath = vrlIndexPath(_path);
+        if (not loadVrlIndex(indexPath, _index) or _index.recordingBytes != fileBytes)
+        {
+            VrlIndexBuilder builder(_maxFrameSize);
+            std::vector<char> chunk(1024*1024);
+            file.seekg(0);
+            while (file.read(chunk.data(), chunk.size()) or file.gcount() > 0)
+            {
+                builder.feed(chunk.data(), size_t(file.gcount()));
+            }
+            _index = builder.index();
+            try
+            {
+                saveVrlIndex(indexPath, _index);
+            }
+            catch (const Pothos::Exception &ex)
+            {
+                poco_warning(Poco::Logger::get("VrlFileSource"), ex.displayText());
+            }
+        }
+
+        //group the frames of each stream for the binary search
+        _streamFrames.clear();
+        _labelFrames.clear();
+        for (size_t pos = 0; pos < _index.entries.size(); pos++)
+        {
+            const auto &entry = _index.entries[pos];
+            if (entry.isStream()) _streamFrames[entry.sid].push_back(pos);
+            else if (entry.isLabels()) _labelFrames[entry.sid].push_back(pos);
+        }
+        _indexLoaded = true;
+    }
+
+    int _fd;
+    std::string _path;
+    bool _indexLoaded;
+    unsigned long long _startOffset;
+    size_t _maxFrameSize;
+    VrlIndex _index;
+    std::map<size_t, std::vector<size_t>> _streamFrames;
+    std::map<size_t, std::vector<size_t>> _labelFrames;
+};
+
+static Pothos::BlockRegistry registerVrlFileSource(
+    "/blocks/vrl_file_source", &VrlFileSource::make);
@@ -0,0 +1,314 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "VrlIndex.hpp"
+#include "SerializeCommon.hpp"
+#include "BinaryEncoding.hpp"
+#include "Lz4.hpp"
+#include "Zstd.hpp"
+#include <Poco/ByteOrder.h>
+#include <Poco/Types.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm> //min/max
+#include <cstring>
+
+/***********************************************************************
+ * Index entries
+ **********************************************************************/
+bool VrlIndexEntry::isStream(void) const
+{
+    return (flags & VITA_EXT) == 0;
+}
+
+bool VrlIndexEntry::isLabels(void) const
+{
+    return (flags & VITA_EXT) != 0 and (flags & VITA_TSF) != 0;
+}
+
+/***********************************************************************
+ * Sidecar file: magic, recording bytes, number of entries,
+ * followed by fixed size entries, all in network byte order
+ **********************************************************************/
+static const char INDEX_MAGIC[8] = {'m', 'V', 'R', 'L', 'I', 'D', 'X', '1'};
+static const size_t INDEX_ENTRY_BYTES = 40;
+
+std::string vrlIndexPath(const std::string &recordingPath)
+{
+    return recordingPath + ".idx";
+}
+
+static void putU32(char *&p, const uint32_t x)
+{
+    const uint32_t n = Poco::ByteOrder::toNetwork(x);
+    std::memcpy(p, &n, sizeof(n));
+    p += sizeof(n);
+}
+
+static void putU64(char *&p, const unsigned long long x)
+{
+    const Poco::UInt64 n = Poco::ByteOrder::toNetwork(Poco::UInt64(x));
+    std::memcpy(p, &n, sizeof(n));
+    p += sizeof(n);
+}
+
+static uint32_t getU32(const char *&p)
+{
+    uint32_t n; std::memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    return Poco::ByteOrder::fromNetwork(n);
+}
+
+static unsigned long long getU64(const char *&p)
+{
+    Poco::UInt64 n; std::memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    return Poco::ByteOrder::fromNetwork(n);
+}
+
+void saveVrlIndex(const std::string &path, const VrlIndex &index)
+{
+    std::vector<char> data(sizeof(INDEX_MAGIC) + 16 + INDEX_ENTRY_BYTES*index.entries.size());
+    char *p = data.data();
+    std::memcpy(p, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    p += sizeof(INDEX_MAGIC);
+    putU64(p, index.recordingBytes);
+    putU64(p, index.entries.size());
+    for (const auto &entry : index.entries)
+    {
+        putU64(p, entry.offset);
+        putU64(p, entry.index);
+        putU64(p, entry.length);
+        putU32(p, entry.frameBytes);
+        putU32(p, entry.sid);
+        putU32(p, entry.flags);
+        putU32(p, 0); //reserved
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(data.data(), data.size());
+    if (not file) throw Pothos::FileException("saveVrlIndex("+path+")", "write failed");
+}
+
+bool loadVrlIndex(const std::string &path, VrlIndex &index)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (not file) return false;
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(INDEX_MAGIC) + 16) return false;
+    if (std::memcmp(data.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0) return false;
+
+    const char *p = data.data() + sizeof(INDEX_MAGIC);
+    index.recordingBytes = getU64(p);
+    const auto numEntries = getU64(p);
+    if (numEntries != (data.size() - sizeof(INDEX_MAGIC) - 16)/INDEX_ENTRY_BYTES) return false;
+    index.entries.resize(size_t(numEntries));
+    for (auto &entry : index.entries)
+    {
+        entry.offset = getU64(p);
+        entry.index = getU64(p);
+        entry.length = getU64(p);
+        entry.frameBytes = getU32(p);
+        entry.sid = getU32(p);
+        entry.flags = getU32(p);
+        getU32(p); //reserved
+    }
+    return true;
+}
+
+/***********************************************************************
+ * Index builder
+ **********************************************************************/
+VrlIndexBuilder::VrlIndexBuilder(const size_t maxFrameSize):
+    _maxFrameSize(maxFrameSize),
+    _skip(0),
+    _hdrOffset(0),
+    _checkTrailer(false)
+{
+    return;
+}
+
+void VrlIndexBuilder::feed(const void *buff, const size_t len)
+{
+    const char *p = static_cast<const char *>(buff);
+    size_t i = 0;
+    while (i < len)
+    {
+        //skip over the remainder of the current frame,
+        //the bytes are kept to search again when the trailer is wrong
+        if (_skip != 0)
+        {
+            const size_t n = size_t(std::min<unsigned long long>(_skip, len - i));
+            _frame.append(p + i, n);
+            i += n;
+            _skip -= n;
+            _index.recordingBytes += n;
+            continue;
+        }
+
+        //verify the trailer of the current frame
+        if (_checkTrailer)
+        {
+            const size_t n = std::min(4 - _tlr.size(), len - i);
+            _tlr.append(p + i, n);
+            i += n;
+            _index.recordingBytes += n;
+            if (_tlr.size() < 4) continue;
+            uint32_t vend = 0;
+            std::memcpy(&vend, _tlr.data(), 4);
+            _checkTrailer = false;
+            _frame += _tlr;
+            _tlr.clear();
+            if (Poco::ByteOrder::fromNetwork(vend) == VEND)
+            {
+                _frame.clear();
+                continue;
+            }
+
+            //not a frame, search again after the magic word,
+            //real frames may begin inside of the false frame
+            _index.entries.pop_back();
+            const std::string rescan(_frame.substr(4));
+            _frame.clear();
+            _index.recordingBytes -= rescan.size();
+            this->feed(rescan.data(), rescan.size());
+            continue;
+        }
+
+        //search for the start of the next frame
+        if (_hdr.empty())
+        {
+            const void *found = std::memchr(p + i, 'm', len - i);
+            const size_t next = (found == nullptr)? len : size_t(static_cast<const char *>(found) - p);
+            _index.recordingBytes += next - i;
+            i = next;
+            if (i == len) break;
+            _hdrOffset = _index.recordingBytes;
+        }
+
+        //collect the header, the size depends on the header flags
+        const size_t n = std::min(this->headerWant() - _hdr.size(), len - i);
+        _hdr.append(p + i, n);
+        i += n;
+        _index.recordingBytes += n;
+        if (_hdr.size() < this->headerWant()) continue;
+
+        if (this->parseHeader())
+        {
+            _skip = _index.entries.back().frameBytes - _hdr.size() - 4;
+            _checkTrailer = true;
+            _frame.swap(_hdr);
+            _hdr.clear();
+            continue;
+        }
+
+        //not a frame, search again from the next byte
+        const std::string rescan(_hdr.substr(1));
+        _hdr.clear();
+        _index.recordingBytes -= rescan.size();
+        this->feed(rescan.data(), rescan.size());
+    }
+}
+
+size_t VrlIndexBuilder::headerWant(void) const
+{
+    if (_hdr.size() < 12) return 12;
+    uint32_t vita_hdr = 0;
+    std::memcpy(&vita_hdr, _hdr.data() + 8, 4);
+    vita_hdr = Poco::ByteOrder::fromNetwork(vita_hdr);
+    size_t want = 16;
+    if (vita_hdr & VITA_XLEN) want += 4;
+    if (vita_hdr & VITA_TSF) want += 8;
+    if ((vita_hdr & (VITA_LZ4 | VITA_ZSTD)) and not (vita_hdr & VITA_EXT)) want += LZ4_HDR_BYTES;
+    return want;
+}
+
+bool VrlIndexBuilder::parseHeader(void)
+{
+    uint32_t p[8];
+    std::memcpy(p, _hdr.data(), _hdr.size());
+    if (Poco::ByteOrder::fromNetwork(p[0]) != mVRL) return false;
+    const uint32_t vita_hdr = Poco::ByteOrder::fromNetwork(p[2]);
+    if ((vita_hdr & VITA_SID) == 0) return false;
+
+    const bool has_xlen = bool(vita_hdr & VITA_XLEN);
+    const bool has_tsf = bool(vita_hdr & VITA_TSF);
+    const size_t hdr_bytes = 16 + (has_xlen? 4 : 0) + (has_tsf? 8 : 0);
+    const size_t tlr_bytes = (vita_hdr & VITA_CRC)? 8 : 4;
+    const size_t pkt_bytes = packetBytes(p);
+    if (pkt_bytes < MIN_PKT_BYTES) return false;
+    if (pkt_bytes < _hdr.size() + tlr_bytes) return false;
+    if (pkt_bytes > ((vita_hdr & VITA_EXT)? std::max(_maxFrameSize, MAX_EXT_PKT_BYTES) : _maxFrameSize)) return false;
+
+    VrlIndexEntry entry;
+    entry.offset = _hdrOffset;
+    entry.sid = Poco::ByteOrder::fromNetwork(p[3]);
+    entry.flags = vita_hdr & ~uint32_t(0xfffff); //drop the seq and size fields
+    entry.frameBytes = uint32_t(padUp32(pkt_bytes));
+    entry.length = pkt_bytes - hdr_bytes - tlr_bytes;
+    const size_t tsf_word = has_xlen? 5 : 4;
+    if (has_tsf) entry.index = (uint64_t(Poco::ByteOrder::fromNetwork(p[tsf_word])) << 32) | Poco::ByteOrder::fromNetwork(p[tsf_word+1]);
+    if (hdr_bytes != _hdr.size()) entry.length = Poco::ByteOrder::fromNetwork(p[hdr_bytes/4]); //uncompressed length
+    _index.entries.push_back(entry);
+    return true;
+}
+
+/***********************************************************************
+ * Label frame decoder
+ **********************************************************************/
+std::vector<Pothos::Label> decodeLabelFrame(const void *frame, const size_t length)
+{
+    #define frameCheck(cond) if (not (cond)) throw Pothos::DataFormatException("decodeLabelFrame()", "failed check: " #cond)
+    frameCheck(length >= MIN_PKT_BYTES);
+    uint32_t p[5];
+    std::memcpy(p, frame, sizeof(p));
+    frameCheck(Poco::ByteOrder::fromNetwork(p[0]) == mVRL);
+    const size_t pkt_bytes = packetBytes(p);
+    frameCheck(pkt_bytes <= length);
+
+    const uint32_t vita_hdr = Poco::ByteOrder::fromNetwork(p[2]);
+    frameCheck((vita_hdr & VITA_EXT) and (vita_hdr & VITA_TSF));
+    const size_t hdr_bytes = 16 + ((vita_hdr & VITA_XLEN)? 4 : 0) + 8;
+    const size_t tlr_bytes = (vita_hdr & VITA_CRC)? 8 : 4;
+    frameCheck(pkt_bytes >= hdr_bytes + tlr_bytes);
+    const char *payload = static_cast<const char *>(frame) + hdr_bytes;
+    size_t payloadBytes = pkt_bytes - hdr_bytes - tlr_bytes;
+
+    //LZ4 expands each compressed byte to at most 255 bytes
+    std::vector<char> decompressed;
+    if (vita_hdr & (VITA_LZ4 | VITA_ZSTD))
+    {
+        frameCheck(payloadBytes >= LZ4_HDR_BYTES);
+        uint32_t len = 0;
+        std::memcpy(&len, payload, LZ4_HDR_BYTES);
+        len = Poco::ByteOrder::fromNetwork(len);
+        const bool is_zstd = bool(vita_hdr & VITA_ZSTD);
+        frameCheck(len <= (is_zstd? MAX_EXT_PKT_BYTES : payloadBytes*255));
+        decompressed.resize(len);
+        frameCheck(is_zstd?
+            zstdDecompress(payload + LZ4_HDR_BYTES, payloadBytes - LZ4_HDR_BYTES, decompressed.data(), len):
+            lz4Decompress(payload + LZ4_HDR_BYTES, payloadBytes - LZ4_HDR_BYTES, decompressed.data(), len));
+        payload = decompressed.data();
+        payloadBytes = len;
+    }
+
+    std::vector<Pothos::Label> labels;
+    if (vita_hdr & VITA_BIN)
+    {
+        BinaryDecoder decoder(payload, payloadBytes);
+        do labels.push_back(decoder.decodeLabel());
+        while (not decoder.done());
+    }
+    else
+    {
+        std::istringstream ss(std::string(payload, payloadBytes));
+        do
+        {
+            Pothos::Object obj;
+            obj.deserialize(ss);
+            labels.push_back(obj.extract<Pothos::Label>());
+        }
+        while (ss.peek() != std::char_traits<char>::eof());
+    }
+    return labels;
+}
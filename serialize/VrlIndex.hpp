@@ -0,0 +1,116 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include "SerializeCommon.hpp"
+#include <Pothos/Framework.hpp>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*!
+ * One entry in the index of a mVRL recording.
+ * There is one entry for each frame in the recording.
+ */
+struct VrlIndexEntry
+{
+    VrlIndexEntry(void):
+        offset(0),
+        index(0),
+        length(0),
+        frameBytes(0),
+        sid(0),
+        flags(0)
+    {
+        return;
+    }
+
+    //! The byte offset of the frame in the recording
+    unsigned long long offset;
+
+    //! The stream index of the payload or the first label (TSF)
+    unsigned long long index;
+
+    //! The number of payload bytes, uncompressed for stream frames
+    unsigned long long length;
+
+    //! The size of the frame including padding
+    uint32_t frameBytes;
+
+    //! The stream ID of the frame
+    uint32_t sid;
+
+    //! The VITA header flags of the frame
+    uint32_t flags;
+
+    bool isStream(void) const;
+
+    bool isLabels(void) const;
+};
+
+/*!
+ * The index of a mVRL recording, sorted by frame offset.
+ */
+struct VrlIndex
+{
+    VrlIndex(void):
+        recordingBytes(0)
+    {
+        return;
+    }
+
+    //! The number of recording bytes covered by the index
+    unsigned long long recordingBytes;
+
+    std::vector<VrlIndexEntry> entries;
+};
+
+//! The path of the index sidecar file for a recording
+std::string vrlIndexPath(const std::string &recordingPath);
+
+//! Write the index to a sidecar file, throws on error
+void saveVrlIndex(const std::string &path, const VrlIndex &index);
+
+//! Read the index from a sidecar file, false when missing or invalid
+bool loadVrlIndex(const std::string &path, VrlIndex &index);
+
+/*!
+ * Build the index of a recording from the mVRL byte stream.
+ * The recording is fed in order, in chunks of any size.
+ * Only the header and trailer of each frame are inspected,
+ * and the builder scans for the magic word after corruption.
+ * Stream frames larger than the maximum frame size are treated as corruption,
+ * label and message frames are limited by MAX_EXT_PKT_BYTES instead.
+ */
+class VrlIndexBuilder
+{
+public:
+    VrlIndexBuilder(const size_t maxFrameSize = MAX_PKT_BYTES);
+
+    void feed(const void *buff, const size_t len);
+
+    const VrlIndex &index(void) const
+    {
+        return _index;
+    }
+
+private:
+    size_t headerWant(void) const;
+    bool parseHeader(void);
+    const size_t _maxFrameSize;
+    VrlIndex _index;
+    unsigned long long _skip;
+    unsigned long long _hdrOffset;
+    std::string _hdr;
+    bool _checkTrailer;
+    std::string _tlr;
+    std::string _frame;
+};
+
+/*!
+ * Decode the labels in a complete label frame.
+ * The labels are returned with their absolute stream indexes.
+ * Throws Pothos::DataFormatException on malformed frames.
+ */
+std::vector<Pothos::Label> decodeLabelFrame(const void *frame, const size_t length);
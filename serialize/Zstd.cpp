@@ -0,0 +1,94 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "Zstd.hpp"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <memory>
+
+/***********************************************************************
+ * The contexts hold the compression tables between frames,
+ * one per thread so that frames can be compressed in parallel.
+ **********************************************************************/
+static ZSTD_CCtx *compressContext(void)
+{
+    static thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx *)> ctx(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+    return ctx.get();
+}
+
+static ZSTD_DCtx *decompressContext(void)
+{
+    static thread_local std::unique_ptr<ZSTD_DCtx, size_t(*)(ZSTD_DCtx *)> ctx(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+    return ctx.get();
+}
+
+bool zstdAvailable(void)
+{
+    return true;
+}
+
+int zstdMinLevel(void)
+{
+    return ZSTD_minCLevel();
+}
+
+int zstdMaxLevel(void)
+{
+    return ZSTD_maxCLevel();
+}
+
+size_t zstdCompressBound(const size_t len)
+{
+    return ZSTD_compressBound(len);
+}
+
+size_t zstdCompress(const void *src, const size_t srcLen, void *dst, const size_t dstCapacity, const int level)
+{
+    auto ctx = compressContext();
+    if (ctx == nullptr) return 0;
+    const size_t n = ZSTD_compressCCtx(ctx, dst, dstCapacity, src, srcLen, level);
+    return ZSTD_isError(n)? 0 : n;
+}
+
+bool zstdDecompress(const void *src, const size_t srcLen, void *dst, const size_t dstLen)
+{
+    auto ctx = decompressContext();
+    if (ctx == nullptr) return false;
+    const size_t n = ZSTD_decompressDCtx(ctx, dst, dstLen, src, srcLen);
+    return not ZSTD_isError(n) and n == dstLen;
+}
+
+#else
+
+bool zstdAvailable(void)
+{
+    return false;
+}
+
+int zstdMinLevel(void)
+{
+    return 0;
+}
+
+int zstdMaxLevel(void)
+{
+    return 0;
+}
+
+size_t zstdCompressBound(const size_t len)
+{
+    return len;
+}
+
+size_t zstdCompress(const void *, const size_t, void *, const size_t, const int)
+{
+    return 0;
+}
+
+bool zstdDecompress(const void *, const size_t, void *, const size_t)
+{
+    return false;
+}
+
+#endif //HAVE_ZSTD
@@ -0,0 +1,36 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <cstddef>
+
+/*!
+ * True when the module was built with the optional zstd library.
+ * Without it, compression and decompression always fail.
+ */
+bool zstdAvailable(void);
+
+/*!
+ * The range of supported compression levels.
+ */
+int zstdMinLevel(void);
+int zstdMaxLevel(void);
+
+/*!
+ * The worst case compressed size for an input of the given size.
+ */
+size_t zstdCompressBound(const size_t len);
+
+/*!
+ * Compress a buffer into a zstd frame at the given compression level.
+ * Return the number of compressed bytes,
+ * or 0 when the output does not fit in dstCapacity.
+ */
+size_t zstdCompress(const void *src, const size_t srcLen, void *dst, const size_t dstCapacity, const int level);
+
+/*!
+ * Decompress a zstd frame.
+ * Return true when the input decompressed to exactly dstLen bytes.
+ * Malformed input is detected and never reads or writes out of bounds.
+ */
+bool zstdDecompress(const void *src, const size_t srcLen, void *dst, const size_t dstLen);
@@ -1,9 +1,12 @@
 // Copyright (c) 2014-2017 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "ConverterKernels.hpp"
+#include "WorkerPool.hpp"
 #include <Pothos/Framework.hpp>
 #include <chrono>
 #include <thread>
+#include <memory>
 #include <iostream>
 #include <algorithm> //min
 
@@ -15,6 +18,37 @@
  * specifies the output data type, and the block tries to convert.
  * Input is consumed on input port 0 and produced on output port 0.
  *
+ * Packet payloads are converted into buffers from the output port's
+ * buffer pool, and all enqueued packets are handled per call to work().
+ * Payloads that already match the output type are forwarded as-is,
+ * unless a scale, offset, or clamp is set.
+ * Non-packet messages are forwarded to the output port unchanged.
+ *
+ * <h2>Conversion kernels</h2>
+ *
+ * Common type pairs use SIMD conversion kernels selected at runtime:
+ * int8, int16, and int32 to and from float32 (also complex),
+ * and float64 to and from float32 (also complex).
+ * Float to integer conversions saturate to the output range.
+ * All other type pairs use the generic buffer convert API.
+ * The getKernel() call reports the name of the selected kernel.
+ *
+ * <h2>Scale, offset, and clamp</h2>
+ *
+ * Each output value can be computed as clamp(input*scale + offset).
+ * The arithmetic is fused into the conversion kernel, and the kernel
+ * is specialized so that the default settings pay no extra cost.
+ * For complex types, the arithmetic applies to both real and imaginary parts.
+ * Type pairs without a specialized kernel use an intermediate float64 buffer.
+ *
+ * <h2>Parallel conversion</h2>
+ *
+ * Very large buffers can be split across a small pool of worker threads.
+ * When the number of workers is non-zero, buffers larger than the threshold
+ * are divided into cache-line aligned chunks, one per worker plus one for
+ * the calling thread, and all chunks complete before the output is produced.
+ * Parallel conversion applies to type pairs with a specialized kernel.
+ *
  * |category /Stream
  * |category /Convert
  *
@@ -23,7 +57,45 @@
  * |default "complex_float64"
  * |preview disable
  *
+ * |param scale[Scale] A multiplier applied to each input value.
+ * |default 1.0
+ * |preview valid
+ *
+ * |param offset[Offset] An offset added to each value after scaling.
+ * |default 0.0
+ * |preview valid
+ *
+ * |param clampMin[Clamp Min] The minimum output value.
+ * Clamping is disabled when the minimum is not less than the maximum.
+ * |default 0.0
+ * |preview valid
+ * |tab Clamp
+ *
+ * |param clampMax[Clamp Max] The maximum output value.
+ * Clamping is disabled when the minimum is not less than the maximum.
+ * |default 0.0
+ * |preview valid
+ * |tab Clamp
+ *
+ * |param numWorkers[Num Workers] The number of extra threads for parallel conversion.
+ * A value of 0 (default) disables parallel conversion.
+ * |default 0
+ * |widget SpinBox(minimum=0)
+ * |preview disable
+ * |tab Parallel
+ *
+ * |param parallelThreshold[Parallel Threshold] The minimum output size for parallel conversion.
+ * |default 1048576
+ * |units bytes
+ * |preview disable
+ * |tab Parallel
+ *
  * |factory /blocks/converter(dtype)
+ * |setter setScale(scale)
+ * |setter setOffset(offset)
+ * |setter setClamp(clampMin, clampMax)
+ * |setter setNumWorkers(numWorkers)
+ * |setter setParallelThreshold(parallelThreshold)
  **********************************************************************/
 class Converter : public Pothos::Block
 {
@@ -33,10 +105,94 @@ public:
         return new Converter(dtype);
     }
 
-    Converter(const Pothos::DType &dtype)
+    Converter(const Pothos::DType &dtype):
+        _mode(CONVERT_PLAIN),
+        _numWorkers(0),
+        _parallelThreshold(1024*1024)
     {
         this->setupInput(0);
         this->setupOutput(0, dtype);
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, getKernel));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, setScale));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, getScale));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, setOffset));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, getOffset));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, setClamp));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, setNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, getNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, setParallelThreshold));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Converter, getParallelThreshold));
+    }
+
+    void setScale(const double scale)
+    {
+        _args.scale = scale;
+        this->updateMode();
+    }
+
+    double getScale(void) const
+    {
+        return _args.scale;
+    }
+
+    void setOffset(const double offset)
+    {
+        _args.offset = offset;
+        this->updateMode();
+    }
+
+    double getOffset(void) const
+    {
+        return _args.offset;
+    }
+
+    void setClamp(const double minimum, const double maximum)
+    {
+        _args.minimum = minimum;
+        _args.maximum = maximum;
+        this->updateMode();
+    }
+
+    void setNumWorkers(const size_t numWorkers)
+    {
+        _numWorkers = numWorkers;
+        //pool was running -> restart with the new size
+        if (_workers)
+        {
+            this->deactivate();
+            this->activate();
+        }
+    }
+
+    size_t getNumWorkers(void) const
+    {
+        return _numWorkers;
+    }
+
+    void setParallelThreshold(const size_t threshold)
+    {
+        _parallelThreshold = threshold;
+    }
+
+    size_t getParallelThreshold(void) const
+    {
+        return _parallelThreshold;
+    }
+
+    void activate(void)
+    {
+        if (_numWorkers != 0) _workers.reset(new WorkerPool(_numWorkers));
+    }
+
+    void deactivate(void)
+    {
+        _workers.reset();
+    }
+
+    std::string getKernel(void) const
+    {
+        if (_kernel.fcn == nullptr) return "generic";
+        return _kernel.name;
     }
 
     void work(void)
@@ -44,11 +200,28 @@ public:
         auto inputPort = this->input(0);
         auto outputPort = this->output(0);
 
-        //got a packet message
-        if (inputPort->hasMessage())
+        //got packet messages
+        while (inputPort->hasMessage())
         {
-            auto pkt = inputPort->popMessage().convert<Pothos::Packet>();
-            pkt.payload = pkt.payload.convert(outputPort->dtype());
+            auto msg = inputPort->popMessage();
+            if (msg.type() != typeid(Pothos::Packet))
+            {
+                outputPort->postMessage(std::move(msg));
+                continue;
+            }
+            auto pkt = msg.extract<Pothos::Packet>();
+
+            //convert into a recycled buffer from the output port's pool,
+            //getBuffer() only allocates when the payload exceeds the pool size
+            if (pkt.payload.dtype != outputPort->dtype() or _mode != CONVERT_PLAIN)
+            {
+                const auto numElems = pkt.payload.elements();
+                auto outBuff = outputPort->getBuffer(numElems*outputPort->dtype().size());
+                outBuff.dtype = outputPort->dtype();
+                this->convert(pkt.payload, outBuff, numElems);
+                pkt.payload = std::move(outBuff);
+            }
+
             //labels reference element indexes and should stay the same
             outputPort->postMessage(std::move(pkt));
         }
@@ -59,7 +232,7 @@ public:
         {
             const auto &outBuff = outputPort->buffer();
             size_t numElems = std::min(outBuff.elements(), buff.elements());
-            buff.convert(outBuff, numElems);
+            this->convert(buff, outBuff, numElems);
             outputPort->produce(numElems);
 
             //input type unspecified, convert back to bytes to consume
@@ -76,6 +249,84 @@ public:
             outputPort->postLabel(label.toAdjusted(1, port->buffer().dtype.size()));
         }
     }
+
+private:
+
+    void updateMode(void)
+    {
+        const bool clamp = _args.minimum < _args.maximum;
+        const bool affine = clamp or _args.scale != 1.0 or _args.offset != 0.0;
+        _mode = clamp?CONVERT_AFFINE_CLAMP:(affine?CONVERT_AFFINE:CONVERT_PLAIN);
+        _kernelInType = Pothos::DType(); //force kernel lookup
+    }
+
+    void convert(const Pothos::BufferChunk &inBuff, const Pothos::BufferChunk &outBuff, const size_t numElems)
+    {
+        //select a kernel when the input type changes
+        if (inBuff.dtype != _kernelInType)
+        {
+            _kernel = lookupConvertKernel(inBuff.dtype, outBuff.dtype, _mode);
+            _kernelInType = inBuff.dtype;
+        }
+
+        if (_kernel.fcn != nullptr)
+        {
+            if (_workers and numElems*outBuff.dtype.size() >= _parallelThreshold)
+            {
+                this->convertParallel(inBuff, outBuff, numElems);
+            }
+            else _kernel.fcn(inBuff.as<const void *>(), outBuff.as<void *>(), numElems*_kernel.scalarsPerElem, _args);
+        }
+        else if (_mode == CONVERT_PLAIN) inBuff.convert(outBuff, numElems);
+
+        //no kernel for this pair: apply the arithmetic on an intermediate float64 buffer
+        else
+        {
+            const auto &dtype = inBuff.dtype;
+            const Pothos::DType tmpType(dtype.isComplex()?"complex_float64":"float64", dtype.dimension());
+            const auto tmpBuff = inBuff.convert(tmpType, numElems);
+            applyConvertArgs(tmpBuff.as<double *>(), numElems*tmpType.size()/sizeof(double), _mode, _args);
+            tmpBuff.convert(outBuff, numElems);
+        }
+    }
+
+    void convertParallel(const Pothos::BufferChunk &inBuff, const Pothos::BufferChunk &outBuff, const size_t numElems)
+    {
+        static const size_t CACHE_LINE = 64;
+        const size_t inSize = inBuff.dtype.size();
+        const size_t outSize = outBuff.dtype.size();
+
+        //chunk sizes are a multiple of the elements per cache line
+        size_t a = CACHE_LINE, b = outSize;
+        while (b != 0) {const size_t t = a % b; a = b; b = t;}
+        const size_t align = CACHE_LINE/a;
+
+        //chunk boundaries begin at the first cache line aligned output element
+        const size_t misalign = (CACHE_LINE - (outBuff.address % CACHE_LINE)) % CACHE_LINE;
+        const size_t skew = ((misalign % outSize) == 0)? misalign/outSize : 0;
+
+        const size_t numTasks = _workers->size();
+        size_t chunk = (numElems + numTasks - 1)/numTasks;
+        chunk = ((chunk + align - 1)/align)*align;
+
+        const auto in = inBuff.as<const char *>();
+        const auto out = outBuff.as<char *>();
+        _workers->run(numTasks, [&](const size_t i)
+        {
+            const size_t first = (i == 0)? 0 : std::min(numElems, skew + i*chunk);
+            const size_t last = std::min(numElems, skew + (i+1)*chunk);
+            if (first >= last) return;
+            _kernel.fcn(in + first*inSize, out + first*outSize, (last-first)*_kernel.scalarsPerElem, _args);
+        });
+    }
+
+    ConvertMode _mode;
+    ConvertArgs _args;
+    ConvertKernel _kernel;
+    Pothos::DType _kernelInType;
+    size_t _numWorkers;
+    size_t _parallelThreshold;
+    std::unique_ptr<WorkerPool> _workers;
 };
 
 static Pothos::BlockRegistry registerConverter(
@@ -0,0 +1,756 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include "ConverterKernels.hpp"
+#include <limits>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CONVERT_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define CONVERT_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+/***********************************************************************
+ * Scalar kernels -- used for tails and when no SIMD is available
+ **********************************************************************/
+template <typename OutT, typename InT>
+static inline OutT saturate(const InT x)
+{
+    if (x != x) return OutT(0); //NaN
+    if (x <= InT(std::numeric_limits<OutT>::min())) return std::numeric_limits<OutT>::min();
+    if (x >= InT(std::numeric_limits<OutT>::max())) return std::numeric_limits<OutT>::max();
+    return OutT(x);
+}
+
+//arithmetic is performed in float64 when either side is float64, otherwise float32
+template <typename InT, typename OutT>
+struct WorkType
+{
+    typedef float type;
+};
+
+template <typename OutT>
+struct WorkType<double, OutT>
+{
+    typedef double type;
+};
+
+template <typename InT>
+struct WorkType<InT, double>
+{
+    typedef double type;
+};
+
+template <>
+struct WorkType<double, double>
+{
+    typedef double type;
+};
+
+template <ConvertMode Mode, typename W>
+static inline W applyArgs(W x, const W scale, const W offset, const W lo, const W hi)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = x*scale + offset;
+    if (Mode == CONVERT_AFFINE_CLAMP) x = (x < lo)? lo : ((x > hi)? hi : x);
+    return x;
+}
+
+template <typename OutT, typename W, bool IsInteger>
+struct ScalarStore
+{
+    static inline OutT apply(const W x)
+    {
+        return OutT(x);
+    }
+};
+
+template <typename OutT, typename W>
+struct ScalarStore<OutT, W, true>
+{
+    static inline OutT apply(const W x)
+    {
+        return saturate<OutT>(x);
+    }
+};
+
+template <typename InT, typename OutT, ConvertMode Mode>
+static void convertScalar(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    typedef typename WorkType<InT, OutT>::type W;
+    typedef ScalarStore<OutT, W, std::numeric_limits<OutT>::is_integer> Store;
+    const W scale(args.scale), offset(args.offset), lo(args.minimum), hi(args.maximum);
+    const InT *pIn = reinterpret_cast<const InT *>(in);
+    OutT *pOut = reinterpret_cast<OutT *>(out);
+    for (size_t i = 0; i < num; i++)
+    {
+        pOut[i] = Store::apply(applyArgs<Mode>(W(pIn[i]), scale, offset, lo, hi));
+    }
+}
+
+//convert the remaining elements after a vectorized loop
+template <ConvertMode Mode, typename InT, typename OutT>
+static inline void convertTail(const InT *in, OutT *out, const size_t i, const size_t num, const ConvertArgs &args)
+{
+    convertScalar<InT, OutT, Mode>(in+i, out+i, num-i, args);
+}
+
+void applyConvertArgs(double *buff, const size_t num, const ConvertMode mode, const ConvertArgs &args)
+{
+    if (mode == CONVERT_AFFINE) convertScalar<double, double, CONVERT_AFFINE>(buff, buff, num, args);
+    if (mode == CONVERT_AFFINE_CLAMP) convertScalar<double, double, CONVERT_AFFINE_CLAMP>(buff, buff, num, args);
+}
+
+/***********************************************************************
+ * AVX2 kernels
+ **********************************************************************/
+#ifdef CONVERT_KERNELS_X86
+
+#define AVX2 __attribute__((target("avx2")))
+
+struct Avx2Args
+{
+    __m256 scale, offset, lo, hi;
+};
+
+AVX2 static inline Avx2Args loadArgsAvx2(const ConvertArgs &args)
+{
+    Avx2Args a;
+    a.scale = _mm256_set1_ps(float(args.scale));
+    a.offset = _mm256_set1_ps(float(args.offset));
+    a.lo = _mm256_set1_ps(float(args.minimum));
+    a.hi = _mm256_set1_ps(float(args.maximum));
+    return a;
+}
+
+template <ConvertMode Mode>
+AVX2 static inline __m256 applyArgsAvx2(__m256 x, const Avx2Args &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = _mm256_add_ps(_mm256_mul_ps(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = _mm256_min_ps(a.hi, _mm256_max_ps(a.lo, x)); //NaN passes through
+    return x;
+}
+
+struct Avx2ArgsF64
+{
+    __m256d scale, offset, lo, hi;
+};
+
+AVX2 static inline Avx2ArgsF64 loadArgsAvx2F64(const ConvertArgs &args)
+{
+    Avx2ArgsF64 a;
+    a.scale = _mm256_set1_pd(args.scale);
+    a.offset = _mm256_set1_pd(args.offset);
+    a.lo = _mm256_set1_pd(args.minimum);
+    a.hi = _mm256_set1_pd(args.maximum);
+    return a;
+}
+
+template <ConvertMode Mode>
+AVX2 static inline __m256d applyArgsAvx2F64(__m256d x, const Avx2ArgsF64 &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = _mm256_add_pd(_mm256_mul_pd(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = _mm256_min_pd(a.hi, _mm256_max_pd(a.lo, x)); //NaN passes through
+    return x;
+}
+
+template <ConvertMode Mode>
+AVX2 static void int8_to_float32_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int8_t *pIn = reinterpret_cast<const int8_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx2(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m256i x = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pIn+i)));
+        _mm256_storeu_ps(pOut+i, applyArgsAvx2<Mode>(_mm256_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void int16_to_float32_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int16_t *pIn = reinterpret_cast<const int16_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx2(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pIn+i)));
+        _mm256_storeu_ps(pOut+i, applyArgsAvx2<Mode>(_mm256_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void int32_to_float32_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int32_t *pIn = reinterpret_cast<const int32_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx2(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pIn+i));
+        _mm256_storeu_ps(pOut+i, applyArgsAvx2<Mode>(_mm256_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+//NaN converts to 0 as in the scalar kernels
+AVX2 static inline __m256 zeroNaNAvx2(const __m256 x)
+{
+    return _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+}
+
+//float to int32 with truncation, clamped in float for narrower outputs
+template <ConvertMode Mode>
+AVX2 static inline __m256i float32_to_int32_avx2_vec(__m256 x, const Avx2Args &a, const float lo, const float hi)
+{
+    x = zeroNaNAvx2(applyArgsAvx2<Mode>(x, a));
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(lo)), _mm256_set1_ps(hi));
+    return _mm256_cvttps_epi32(x);
+}
+
+template <ConvertMode Mode>
+AVX2 static void float32_to_int8_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int8_t *pOut = reinterpret_cast<int8_t *>(out);
+    const auto a = loadArgsAvx2(args);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i+32 <= num; i += 32)
+    {
+        const __m256i w = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+0), a, -128.f, 127.f);
+        const __m256i x = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+8), a, -128.f, 127.f);
+        const __m256i y = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+16), a, -128.f, 127.f);
+        const __m256i z = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+24), a, -128.f, 127.f);
+        const __m256i wx = _mm256_packs_epi32(w, x);
+        const __m256i yz = _mm256_packs_epi32(y, z);
+        const __m256i wxyz = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(wx, yz), order);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pOut+i), wxyz);
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void float32_to_int16_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int16_t *pOut = reinterpret_cast<int16_t *>(out);
+    const auto a = loadArgsAvx2(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m256i x = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+0), a, -32768.f, 32767.f);
+        const __m256i y = float32_to_int32_avx2_vec<Mode>(_mm256_loadu_ps(pIn+i+8), a, -32768.f, 32767.f);
+        const __m256i xy = _mm256_permute4x64_epi64(_mm256_packs_epi32(x, y), 0xd8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pOut+i), xy);
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void float32_to_int32_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int32_t *pOut = reinterpret_cast<int32_t *>(out);
+    const auto a = loadArgsAvx2(args);
+    const __m256 overflow = _mm256_set1_ps(2147483648.f);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m256 x = zeroNaNAvx2(applyArgsAvx2<Mode>(_mm256_loadu_ps(pIn+i), a));
+        //cvtt produces 0x80000000 on overflow, flip it to INT_MAX for large positives
+        const __m256i mask = _mm256_castps_si256(_mm256_cmp_ps(x, overflow, _CMP_GE_OQ));
+        const __m256i r = _mm256_xor_si256(_mm256_cvttps_epi32(x), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pOut+i), r);
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void float64_to_float32_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const double *pIn = reinterpret_cast<const double *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx2F64(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        const __m256d x = applyArgsAvx2F64<Mode>(_mm256_loadu_pd(pIn+i), a);
+        _mm_storeu_ps(pOut+i, _mm256_cvtpd_ps(x));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX2 static void float32_to_float64_avx2(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    double *pOut = reinterpret_cast<double *>(out);
+    const auto a = loadArgsAvx2F64(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        const __m256d x = _mm256_cvtps_pd(_mm_loadu_ps(pIn+i));
+        _mm256_storeu_pd(pOut+i, applyArgsAvx2F64<Mode>(x, a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+/***********************************************************************
+ * AVX-512 kernels
+ **********************************************************************/
+#define AVX512 __attribute__((target("avx512f")))
+
+struct Avx512Args
+{
+    __m512 scale, offset, lo, hi;
+};
+
+AVX512 static inline Avx512Args loadArgsAvx512(const ConvertArgs &args)
+{
+    Avx512Args a;
+    a.scale = _mm512_set1_ps(float(args.scale));
+    a.offset = _mm512_set1_ps(float(args.offset));
+    a.lo = _mm512_set1_ps(float(args.minimum));
+    a.hi = _mm512_set1_ps(float(args.maximum));
+    return a;
+}
+
+template <ConvertMode Mode>
+AVX512 static inline __m512 applyArgsAvx512(__m512 x, const Avx512Args &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = _mm512_add_ps(_mm512_mul_ps(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = _mm512_min_ps(a.hi, _mm512_max_ps(a.lo, x)); //NaN passes through
+    return x;
+}
+
+struct Avx512ArgsF64
+{
+    __m512d scale, offset, lo, hi;
+};
+
+AVX512 static inline Avx512ArgsF64 loadArgsAvx512F64(const ConvertArgs &args)
+{
+    Avx512ArgsF64 a;
+    a.scale = _mm512_set1_pd(args.scale);
+    a.offset = _mm512_set1_pd(args.offset);
+    a.lo = _mm512_set1_pd(args.minimum);
+    a.hi = _mm512_set1_pd(args.maximum);
+    return a;
+}
+
+template <ConvertMode Mode>
+AVX512 static inline __m512d applyArgsAvx512F64(__m512d x, const Avx512ArgsF64 &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = _mm512_add_pd(_mm512_mul_pd(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = _mm512_min_pd(a.hi, _mm512_max_pd(a.lo, x)); //NaN passes through
+    return x;
+}
+
+template <ConvertMode Mode>
+AVX512 static void int8_to_float32_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int8_t *pIn = reinterpret_cast<const int8_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx512(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512i x = _mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pIn+i)));
+        _mm512_storeu_ps(pOut+i, applyArgsAvx512<Mode>(_mm512_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void int16_to_float32_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int16_t *pIn = reinterpret_cast<const int16_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx512(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512i x = _mm512_cvtepi16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(pIn+i)));
+        _mm512_storeu_ps(pOut+i, applyArgsAvx512<Mode>(_mm512_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void int32_to_float32_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int32_t *pIn = reinterpret_cast<const int32_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx512(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512i x = _mm512_loadu_si512(pIn+i);
+        _mm512_storeu_ps(pOut+i, applyArgsAvx512<Mode>(_mm512_cvtepi32_ps(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static inline __m512i float32_to_int32_avx512_vec(__m512 x, const Avx512Args &a, const float lo, const float hi)
+{
+    x = applyArgsAvx512<Mode>(x, a);
+    x = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(x, x, _CMP_ORD_Q), x); //NaN converts to 0
+    x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(lo)), _mm512_set1_ps(hi));
+    return _mm512_cvttps_epi32(x);
+}
+
+template <ConvertMode Mode>
+AVX512 static void float32_to_int8_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int8_t *pOut = reinterpret_cast<int8_t *>(out);
+    const auto a = loadArgsAvx512(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512i x = float32_to_int32_avx512_vec<Mode>(_mm512_loadu_ps(pIn+i), a, -128.f, 127.f);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pOut+i), _mm512_cvtsepi32_epi8(x));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void float32_to_int16_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int16_t *pOut = reinterpret_cast<int16_t *>(out);
+    const auto a = loadArgsAvx512(args);
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512i x = float32_to_int32_avx512_vec<Mode>(_mm512_loadu_ps(pIn+i), a, -32768.f, 32767.f);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pOut+i), _mm512_cvtsepi32_epi16(x));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void float32_to_int32_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int32_t *pOut = reinterpret_cast<int32_t *>(out);
+    const auto a = loadArgsAvx512(args);
+    const __m512 overflow = _mm512_set1_ps(2147483648.f);
+    const __m512i intMax = _mm512_set1_epi32(std::numeric_limits<int32_t>::max());
+    size_t i = 0;
+    for (; i+16 <= num; i += 16)
+    {
+        const __m512 x = applyArgsAvx512<Mode>(_mm512_loadu_ps(pIn+i), a);
+        const __mmask16 mask = _mm512_cmp_ps_mask(x, overflow, _CMP_GE_OQ);
+        const __mmask16 ordered = _mm512_cmp_ps_mask(x, x, _CMP_ORD_Q); //NaN converts to 0
+        const __m512i r = _mm512_mask_mov_epi32(_mm512_maskz_cvttps_epi32(ordered, x), mask, intMax);
+        _mm512_storeu_si512(pOut+i, r);
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void float64_to_float32_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const double *pIn = reinterpret_cast<const double *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsAvx512F64(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m512d x = applyArgsAvx512F64<Mode>(_mm512_loadu_pd(pIn+i), a);
+        _mm256_storeu_ps(pOut+i, _mm512_cvtpd_ps(x));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+AVX512 static void float32_to_float64_avx512(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    double *pOut = reinterpret_cast<double *>(out);
+    const auto a = loadArgsAvx512F64(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const __m512d x = _mm512_cvtps_pd(_mm256_loadu_ps(pIn+i));
+        _mm512_storeu_pd(pOut+i, applyArgsAvx512F64<Mode>(x, a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+#endif //CONVERT_KERNELS_X86
+
+/***********************************************************************
+ * NEON kernels
+ **********************************************************************/
+#ifdef CONVERT_KERNELS_NEON
+
+struct NeonArgs
+{
+    float32x4_t scale, offset, lo, hi;
+};
+
+static inline NeonArgs loadArgsNeon(const ConvertArgs &args)
+{
+    NeonArgs a;
+    a.scale = vdupq_n_f32(float(args.scale));
+    a.offset = vdupq_n_f32(float(args.offset));
+    a.lo = vdupq_n_f32(float(args.minimum));
+    a.hi = vdupq_n_f32(float(args.maximum));
+    return a;
+}
+
+template <ConvertMode Mode>
+static inline float32x4_t applyArgsNeon(float32x4_t x, const NeonArgs &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = vaddq_f32(vmulq_f32(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = vminq_f32(vmaxq_f32(x, a.lo), a.hi);
+    return x;
+}
+
+struct NeonArgsF64
+{
+    float64x2_t scale, offset, lo, hi;
+};
+
+static inline NeonArgsF64 loadArgsNeonF64(const ConvertArgs &args)
+{
+    NeonArgsF64 a;
+    a.scale = vdupq_n_f64(args.scale);
+    a.offset = vdupq_n_f64(args.offset);
+    a.lo = vdupq_n_f64(args.minimum);
+    a.hi = vdupq_n_f64(args.maximum);
+    return a;
+}
+
+template <ConvertMode Mode>
+static inline float64x2_t applyArgsNeonF64(float64x2_t x, const NeonArgsF64 &a)
+{
+    if (Mode == CONVERT_PLAIN) return x;
+    x = vaddq_f64(vmulq_f64(x, a.scale), a.offset);
+    if (Mode == CONVERT_AFFINE_CLAMP) x = vminq_f64(vmaxq_f64(x, a.lo), a.hi);
+    return x;
+}
+
+template <ConvertMode Mode>
+static void int8_to_float32_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int8_t *pIn = reinterpret_cast<const int8_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const int16x8_t x = vmovl_s8(vld1_s8(pIn+i));
+        vst1q_f32(pOut+i+0, applyArgsNeon<Mode>(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), a));
+        vst1q_f32(pOut+i+4, applyArgsNeon<Mode>(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void int16_to_float32_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int16_t *pIn = reinterpret_cast<const int16_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const int16x8_t x = vld1q_s16(pIn+i);
+        vst1q_f32(pOut+i+0, applyArgsNeon<Mode>(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), a));
+        vst1q_f32(pOut+i+4, applyArgsNeon<Mode>(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void int32_to_float32_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const int32_t *pIn = reinterpret_cast<const int32_t *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        vst1q_f32(pOut+i, applyArgsNeon<Mode>(vcvtq_f32_s32(vld1q_s32(pIn+i)), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+//the fcvtzs instruction truncates and saturates to the int32 range
+template <ConvertMode Mode>
+static void float32_to_int8_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int8_t *pOut = reinterpret_cast<int8_t *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const int32x4_t x = vcvtq_s32_f32(applyArgsNeon<Mode>(vld1q_f32(pIn+i+0), a));
+        const int32x4_t y = vcvtq_s32_f32(applyArgsNeon<Mode>(vld1q_f32(pIn+i+4), a));
+        const int16x8_t xy = vcombine_s16(vqmovn_s32(x), vqmovn_s32(y));
+        vst1_s8(pOut+i, vqmovn_s16(xy));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void float32_to_int16_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int16_t *pOut = reinterpret_cast<int16_t *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+8 <= num; i += 8)
+    {
+        const int32x4_t x = vcvtq_s32_f32(applyArgsNeon<Mode>(vld1q_f32(pIn+i+0), a));
+        const int32x4_t y = vcvtq_s32_f32(applyArgsNeon<Mode>(vld1q_f32(pIn+i+4), a));
+        vst1q_s16(pOut+i, vcombine_s16(vqmovn_s32(x), vqmovn_s32(y)));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void float32_to_int32_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    int32_t *pOut = reinterpret_cast<int32_t *>(out);
+    const auto a = loadArgsNeon(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        vst1q_s32(pOut+i, vcvtq_s32_f32(applyArgsNeon<Mode>(vld1q_f32(pIn+i), a)));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void float64_to_float32_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const double *pIn = reinterpret_cast<const double *>(in);
+    float *pOut = reinterpret_cast<float *>(out);
+    const auto a = loadArgsNeonF64(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        const float32x2_t x = vcvt_f32_f64(applyArgsNeonF64<Mode>(vld1q_f64(pIn+i+0), a));
+        const float32x2_t y = vcvt_f32_f64(applyArgsNeonF64<Mode>(vld1q_f64(pIn+i+2), a));
+        vst1q_f32(pOut+i, vcombine_f32(x, y));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+template <ConvertMode Mode>
+static void float32_to_float64_neon(const void *in, void *out, const size_t num, const ConvertArgs &args)
+{
+    const float *pIn = reinterpret_cast<const float *>(in);
+    double *pOut = reinterpret_cast<double *>(out);
+    const auto a = loadArgsNeonF64(args);
+    size_t i = 0;
+    for (; i+4 <= num; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(pIn+i);
+        vst1q_f64(pOut+i+0, applyArgsNeonF64<Mode>(vcvt_f64_f32(vget_low_f32(x)), a));
+        vst1q_f64(pOut+i+2, applyArgsNeonF64<Mode>(vcvt_high_f64_f32(x), a));
+    }
+    convertTail<Mode>(pIn, pOut, i, num, args);
+}
+
+#endif //CONVERT_KERNELS_NEON
+
+/***********************************************************************
+ * Kernel table and runtime dispatch
+ **********************************************************************/
+struct ConvertKernelEntry
+{
+    const char *in;
+    const char *out;
+    ConvertKernelFcn scalar[3];
+    ConvertKernelFcn avx2[3];
+    ConvertKernelFcn avx512[3];
+    ConvertKernelFcn neon[3];
+};
+
+#define KERNEL_MODES(fcn) {&fcn<CONVERT_PLAIN>, &fcn<CONVERT_AFFINE>, &fcn<CONVERT_AFFINE_CLAMP>}
+#define SCALAR_MODES(inT, outT) {&convertScalar<inT, outT, CONVERT_PLAIN>, &convertScalar<inT, outT, CONVERT_AFFINE>, &convertScalar<inT, outT, CONVERT_AFFINE_CLAMP>}
+#define NO_KERNEL {nullptr, nullptr, nullptr}
+
+#if defined(CONVERT_KERNELS_X86)
+#define KERNEL_ENTRY(in, out, inT, outT) {#in, #out, SCALAR_MODES(inT, outT), KERNEL_MODES(in ## _to_ ## out ## _avx2), KERNEL_MODES(in ## _to_ ## out ## _avx512), NO_KERNEL}
+#elif defined(CONVERT_KERNELS_NEON)
+#define KERNEL_ENTRY(in, out, inT, outT) {#in, #out, SCALAR_MODES(inT, outT), NO_KERNEL, NO_KERNEL, KERNEL_MODES(in ## _to_ ## out ## _neon)}
+#else
+#define KERNEL_ENTRY(in, out, inT, outT) {#in, #out, SCALAR_MODES(inT, outT), NO_KERNEL, NO_KERNEL, NO_KERNEL}
+#endif
+
+static const ConvertKernelEntry convertKernelTable[] = {
+    KERNEL_ENTRY(int8, float32, int8_t, float),
+    KERNEL_ENTRY(int16, float32, int16_t, float),
+    KERNEL_ENTRY(int32, float32, int32_t, float),
+    KERNEL_ENTRY(float32, int8, float, int8_t),
+    KERNEL_ENTRY(float32, int16, float, int16_t),
+    KERNEL_ENTRY(float32, int32, float, int32_t),
+    KERNEL_ENTRY(float64, float32, double, float),
+    KERNEL_ENTRY(float32, float64, float, double),
+};
+
+static std::string scalarTypeName(const Pothos::DType &dtype)
+{
+    static const std::string complexPrefix("complex_");
+    const auto name = dtype.name();
+    if (name.compare(0, complexPrefix.size(), complexPrefix) == 0) return name.substr(complexPrefix.size());
+    return name;
+}
+
+ConvertKernel lookupConvertKernel(const Pothos::DType &in, const Pothos::DType &out, const ConvertMode mode)
+{
+    ConvertKernel kernel;
+
+    //complex types are only converted to complex types with the same dimension
+    if (in.isComplex() != out.isComplex()) return kernel;
+    if (in.dimension() != out.dimension()) return kernel;
+
+    const auto inName = scalarTypeName(in);
+    const auto outName = scalarTypeName(out);
+    for (const auto &entry : convertKernelTable)
+    {
+        if (inName != entry.in or outName != entry.out) continue;
+
+        //prefer the widest SIMD supported by this CPU
+        const char *isa = "scalar";
+        kernel.fcn = entry.scalar[mode];
+        #ifdef CONVERT_KERNELS_X86
+        if (__builtin_cpu_supports("avx512f")) {kernel.fcn = entry.avx512[mode]; isa = "avx512";}
+        else if (__builtin_cpu_supports("avx2")) {kernel.fcn = entry.avx2[mode]; isa = "avx2";}
+        #endif
+        #ifdef CONVERT_KERNELS_NEON
+        kernel.fcn = entry.neon[mode]; isa = "neon";
+        #endif
+
+        kernel.name = std::string(entry.in) + "_to_" + entry.out + " (" + isa + ")";
+        kernel.scalarsPerElem = in.dimension()*(in.isComplex()?2:1);
+        break;
+    }
+    return kernel;
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#pragma once
+#include <Pothos/Framework.hpp>
+#include <string>
+#include <cstddef>
+
+/*!
+ * Optional arithmetic fused into the conversion loop.
+ * Each output scalar is clamp(input*scale + offset, minimum, maximum).
+ */
+struct ConvertArgs
+{
+    ConvertArgs(void):
+        scale(1.0),
+        offset(0.0),
+        minimum(0.0),
+        maximum(0.0)
+    {
+        return;
+    }
+
+    double scale;
+    double offset;
+    double minimum;
+    double maximum;
+};
+
+/*!
+ * The kernel variants are specialized at compile time so that
+ * the plain conversion does not pay for the unused arithmetic.
+ */
+enum ConvertMode
+{
+    CONVERT_PLAIN, //!< conversion only, args are ignored
+    CONVERT_AFFINE, //!< apply scale and offset
+    CONVERT_AFFINE_CLAMP, //!< apply scale and offset, then clamp
+};
+
+/*!
+ * A conversion kernel converts num scalar values from in to out.
+ * Complex types are converted as interleaved real and imaginary scalars.
+ * Float to integer conversions truncate and saturate to the output range.
+ */
+typedef void (*ConvertKernelFcn)(const void *in, void *out, const size_t num, const ConvertArgs &args);
+
+struct ConvertKernel
+{
+    ConvertKernel(void):
+        fcn(nullptr),
+        scalarsPerElem(0)
+    {
+        return;
+    }
+
+    //! A printable name like "int16_to_float32 (avx2)"
+    std::string name;
+
+    //! The kernel function or nullptr when unavailable
+    ConvertKernelFcn fcn;
+
+    //! The number of scalar values in each input element
+    size_t scalarsPerElem;
+};
+
+/*!
+ * Lookup a specialized conversion kernel for the input and output types.
+ * The fastest kernel supported by the CPU is selected at runtime.
+ * Returns an empty kernel (null fcn) when the pair has no specialization.
+ */
+ConvertKernel lookupConvertKernel(const Pothos::DType &in, const Pothos::DType &out, const ConvertMode mode);
+
+/*!
+ * Apply the fused arithmetic in-place to a buffer of float64 scalars.
+ * Used to scale type pairs that have no specialized kernel.
+ */
+void applyConvertArgs(double *buff, const size_t num, const ConvertMode mode, const ConvertArgs &args);
@@ -1,9 +1,15 @@
 // Copyright (c) 2014-2018 Josh Blum
 // SPDX-License-Identifier: BSL-1.0
 
+#include "WorkerPool.hpp"
 #include <Pothos/Framework.hpp>
 #include <cstring> //memcpy
 #include <algorithm> //min/max
+#include <memory>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /***********************************************************************
  * |PothosDoc Copier
@@ -11,11 +17,46 @@
  * The copier block copies all data from input port 0 to the output port 0.
  * This block is used to bridge connections between incompatible domains.
  *
+ * Packet payloads are copied into buffers from the output port's
+ * buffer pool, and all enqueued messages are handled per call to work().
+ * Non-packet messages are forwarded to the output port unchanged.
+ *
+ * <h2>Large copies</h2>
+ *
+ * Copies at or above the non-temporal threshold use streaming stores on x86 processors.
+ * Streaming stores write around the cache, so that a large copy does not
+ * evict the working set of this thread, which helps when the output is consumed
+ * in another domain or on another core. Other processors use a plain memcpy.
+ *
+ * When the number of workers is non-zero, copies at or above the parallel threshold
+ * are divided into cache-line aligned chunks, one per worker plus one for
+ * the calling thread, and all chunks complete before the output is produced.
+ *
  * |category /Stream
  * |category /Convert
  * |keywords copier copy memcpy
  *
+ * |param nonTemporalThreshold[Non-temporal Threshold] The minimum size for streaming stores.
+ * A value of 0 disables streaming stores.
+ * |default 1048576
+ * |units bytes
+ * |preview disable
+ *
+ * |param numWorkers[Num Workers] The number of extra threads for parallel copies.
+ * A value of 0 (default) disables parallel copies.
+ * |default 0
+ * |widget SpinBox(minimum=0)
+ * |preview disable
+ *
+ * |param parallelThreshold[Parallel Threshold] The minimum size for parallel copies.
+ * |default 4194304
+ * |units bytes
+ * |preview disable
+ *
  * |factory /blocks/copier()
+ * |setter setNonTemporalThreshold(nonTemporalThreshold)
+ * |setter setNumWorkers(numWorkers)
+ * |setter setParallelThreshold(parallelThreshold)
  **********************************************************************/
 class Copier : public Pothos::Block
 {
@@ -25,10 +66,65 @@ public:
         return new Copier();
     }
 
-    Copier(void)
+    Copier(void):
+        _nonTemporalThreshold(1024*1024),
+        _numWorkers(0),
+        _parallelThreshold(4*1024*1024)
     {
         this->setupInput(0);
         this->setupOutput(0);
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, setNonTemporalThreshold));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, getNonTemporalThreshold));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, setNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, getNumWorkers));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, setParallelThreshold));
+        this->registerCall(this, POTHOS_FCN_TUPLE(Copier, getParallelThreshold));
+    }
+
+    void setNonTemporalThreshold(const size_t threshold)
+    {
+        _nonTemporalThreshold = threshold;
+    }
+
+    size_t getNonTemporalThreshold(void) const
+    {
+        return _nonTemporalThreshold;
+    }
+
+    void setNumWorkers(const size_t numWorkers)
+    {
+        _numWorkers = numWorkers;
+        //pool was running -> restart with the new size
+        if (_workers)
+        {
+            this->deactivate();
+            this->activate();
+        }
+    }
+
+    size_t getNumWorkers(void) const
+    {
+        return _numWorkers;
+    }
+
+    void setParallelThreshold(const size_t threshold)
+    {
+        _parallelThreshold = threshold;
+    }
+
+    size_t getParallelThreshold(void) const
+    {
+        return _parallelThreshold;
+    }
+
+    void activate(void)
+    {
+        if (_numWorkers != 0) _workers.reset(new WorkerPool(_numWorkers));
+    }
+
+    void deactivate(void)
+    {
+        _workers.reset();
     }
 
     void work(void)
@@ -36,7 +132,7 @@ public:
         auto inputPort = this->input(0);
         auto outputPort = this->output(0);
 
-        if (inputPort->hasMessage())
+        while (inputPort->hasMessage())
         {
             auto m = inputPort->popMessage();
             if (m.type() == typeid(Pothos::Packet))
@@ -44,7 +140,7 @@ public:
                 auto pkt = m.extract<Pothos::Packet>();
                 auto outBuff = outputPort->getBuffer(pkt.payload.length);
                 outBuff.dtype = pkt.payload.dtype;
-                std::memcpy(outBuff.as<void *>(), pkt.payload.as<const void *>(), outBuff.length);
+                this->copy(outBuff.as<void *>(), pkt.payload.as<const void *>(), outBuff.length);
                 pkt.payload = std::move(outBuff);
                 outputPort->postMessage(std::move(pkt));
             }
@@ -61,13 +157,82 @@ public:
         outBuff.length = std::min(inBuff.elements(), outBuff.elements())*outBuff.dtype.size();
 
         //copy input to output
-        std::memcpy(outBuff.as<void *>(), inBuff.as<const void *>(), outBuff.length);
+        this->copy(outBuff.as<void *>(), inBuff.as<const void *>(), outBuff.length);
 
         //produce/consume
         inputPort->consume(outBuff.length);
         outputPort->popElements(outBuff.length);
         outputPort->postBuffer(outBuff);
     }
+
+private:
+
+    void copy(void *dst, const void *src, const size_t len)
+    {
+        const bool nonTemporal = _nonTemporalThreshold != 0 and len >= _nonTemporalThreshold;
+        if (not _workers or len < _parallelThreshold) return copyBytes(dst, src, len, nonTemporal);
+
+        //chunk boundaries are cache line aligned in the output
+        static const size_t CACHE_LINE = 64;
+        const size_t skew = (CACHE_LINE - (size_t(dst) % CACHE_LINE)) % CACHE_LINE;
+        const size_t numTasks = _workers->size();
+        size_t chunk = (len + numTasks - 1)/numTasks;
+        chunk = ((chunk + CACHE_LINE - 1)/CACHE_LINE)*CACHE_LINE;
+
+        const auto out = static_cast<char *>(dst);
+        const auto in = static_cast<const char *>(src);
+        _workers->run(numTasks, [&](const size_t i)
+        {
+            const size_t first = (i == 0)? 0 : std::min(len, skew + i*chunk);
+            const size_t last = std::min(len, skew + (i+1)*chunk);
+            if (first >= last) return;
+            copyBytes(out + first, in + first, last - first, nonTemporal);
+        });
+    }
+
+    static void copyBytes(void *dst, const void *src, size_t len, const bool nonTemporal)
+    {
+        #ifdef __SSE2__
+        if (nonTemporal)
+        {
+            auto out = static_cast<char *>(dst);
+            auto in = static_cast<const char *>(src);
+
+            //plain copy up to the first 16 byte aligned output address
+            const size_t head = std::min(len, (16 - (size_t(out) % 16)) % 16);
+            std::memcpy(out, in, head);
+            out += head; in += head; len -= head;
+
+            //stream one cache line per iteration
+            for (; len >= 64; len -= 64, out += 64, in += 64)
+            {
+                const auto pIn = reinterpret_cast<const __m128i *>(in);
+                const auto pOut = reinterpret_cast<__m128i *>(out);
+                const __m128i x0 = _mm_loadu_si128(pIn+0);
+                const __m128i x1 = _mm_loadu_si128(pIn+1);
+                const __m128i x2 = _mm_loadu_si128(pIn+2);
+                const __m128i x3 = _mm_loadu_si128(pIn+3);
+                _mm_stream_si128(pOut+0, x0);
+                _mm_stream_si128(pOut+1, x1);
+                _mm_stream_si128(pOut+2, x2);
+                _mm_stream_si128(pOut+3, x3);
+            }
+
+            //order the streaming stores before the buffer is posted
+            _mm_sfence();
+            std::memcpy(out, in, len);
+            return;
+        }
+        #else
+        (void)nonTemporal;
+        #endif //__SSE2__
+        std::memcpy(dst, src, len);
+    }
+
+    size_t _nonTemporalThreshold;
+    size_t _numWorkers;
+    size_t _parallelThreshold;
+    std::unique_ptr<WorkerPool> _workers;
 };
 
 static Pothos::BlockRegistry registerCopier(
@@ -6,6 +6,11 @@
 #include <Pothos/Proxy.hpp>
 #include <Pothos/Remote.hpp>
 #include <iostream>
+#include <algorithm> //min/max
+#include <cstdlib> //rand
+#include <vector>
+#include <limits>
+#include <cstdint>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -33,3 +38,202 @@ POTHOS_TEST_BLOCK("/blocks/tests", test_converter)
 
     collector.call("verifyTestPlan", expected);
 }
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_converter_packets)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "short");
+    auto converter = Pothos::BlockRegistry::make("/blocks/converter", "float32");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "float32");
+
+    //create several test packets
+    const size_t numPackets = 10;
+    for (size_t n = 0; n < numPackets; n++)
+    {
+        Pothos::Packet p;
+        p.payload = Pothos::BufferChunk("int16", 100+n);
+        for (size_t i = 0; i < p.payload.elements(); i++)
+            p.payload.as<short *>()[i] = short(i*n);
+        p.labels.push_back(Pothos::Label("test", n, n));
+        feeder.call("feedPacket", p);
+    }
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, converter, 0);
+        topology.connect(converter, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //check the converted payloads
+    const std::vector<Pothos::Packet> packets = collector.call("getPackets");
+    POTHOS_TEST_EQUAL(packets.size(), numPackets);
+    for (size_t n = 0; n < numPackets; n++)
+    {
+        const auto &p = packets[n];
+        POTHOS_TEST_TRUE(p.payload.dtype == Pothos::DType("float32"));
+        POTHOS_TEST_EQUAL(p.payload.elements(), 100+n);
+        for (size_t i = 0; i < p.payload.elements(); i++)
+        {
+            POTHOS_TEST_EQUAL(p.payload.as<const float *>()[i], float(short(i*n)));
+        }
+        POTHOS_TEST_EQUAL(p.labels.size(), 1);
+        POTHOS_TEST_EQUAL(p.labels[0].index, n);
+    }
+}
+
+template <typename OutT>
+static void test_converter_kernel(const std::string &outType)
+{
+    std::cout << "testing float32 kernel to " << outType << std::endl;
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "float32");
+    auto converter = Pothos::BlockRegistry::make("/blocks/converter", outType);
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", outType);
+
+    //create test data with out of range values,
+    //and NaN in the vector body and in the scalar tail
+    Pothos::BufferChunk b0("float32", 1000);
+    for (size_t i = 0; i < b0.elements(); i++)
+        b0.as<float *>()[i] = (float(i)-500)*100;
+    b0.as<float *>()[1] = 1e10f;
+    b0.as<float *>()[2] = -1e10f;
+    for (const size_t i : {0, 5, 17, 500, 998, 999})
+        b0.as<float *>()[i] = std::numeric_limits<float>::quiet_NaN();
+    feeder.call("feedBuffer", b0);
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, converter, 0);
+        topology.connect(converter, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    const std::string kernel = converter.call("getKernel");
+    std::cout << "kernel " << kernel << std::endl;
+    POTHOS_TEST_EQUAL(kernel.find("float32_to_"+outType), 0);
+
+    //check the saturated result, NaN converts to 0 at any position
+    const Pothos::BufferChunk buffer = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buffer.elements(), b0.elements());
+    for (size_t i = 0; i < b0.elements(); i++)
+    {
+        const double in = b0.as<const float *>()[i];
+        const double lo = std::numeric_limits<OutT>::min();
+        const double hi = std::numeric_limits<OutT>::max();
+        const OutT x = (in != in)? OutT(0) : OutT(std::max(lo, std::min(hi, in)));
+        POTHOS_TEST_EQUAL(buffer.as<const OutT *>()[i], x);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_converter_kernels)
+{
+    test_converter_kernel<int8_t>("int8");
+    test_converter_kernel<int16_t>("int16");
+    test_converter_kernel<int32_t>("int32");
+}
+
+static void test_converter_scaled(const std::string &outType)
+{
+    std::cout << "testing scaled conversion to " << outType << std::endl;
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int16");
+    auto converter = Pothos::BlockRegistry::make("/blocks/converter", outType);
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "float64");
+    auto toDouble = Pothos::BlockRegistry::make("/blocks/converter", "float64");
+    converter.call("setScale", 0.5);
+    converter.call("setOffset", 10.0);
+    converter.call("setClamp", -1000.0, 1000.0);
+
+    Pothos::BufferChunk b0("int16", 1000);
+    for (size_t i = 0; i < b0.elements(); i++)
+        b0.as<short *>()[i] = short((int(i)-500)*5);
+    feeder.call("feedBuffer", b0);
+
+    //a packet that already has the output type is scaled as well
+    Pothos::Packet pkt;
+    pkt.payload = Pothos::BufferChunk(outType, 100);
+    for (size_t i = 0; i < pkt.payload.elements(); i++)
+    {
+        const double x = (int(i)-50)*50.0;
+        if (outType == "float32") pkt.payload.as<float *>()[i] = float(x);
+        else pkt.payload.as<double *>()[i] = x;
+    }
+    feeder.call("feedPacket", pkt);
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, converter, 0);
+        topology.connect(converter, 0, toDouble, 0);
+        topology.connect(toDouble, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //check the scaled and clamped result
+    const Pothos::BufferChunk buffer = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buffer.elements(), b0.elements());
+    for (size_t i = 0; i < b0.elements(); i++)
+    {
+        const double x = std::max(-1000.0, std::min(1000.0, b0.as<const short *>()[i]*0.5 + 10.0));
+        POTHOS_TEST_EQUAL(buffer.as<const double *>()[i], x);
+    }
+
+    //check the scaled and clamped packet
+    const std::vector<Pothos::Packet> packets = collector.call("getPackets");
+    POTHOS_TEST_EQUAL(packets.size(), 1);
+    const auto &payload = packets[0].payload;
+    POTHOS_TEST_EQUAL(payload.elements(), pkt.payload.elements());
+    for (size_t i = 0; i < payload.elements(); i++)
+    {
+        const double x = std::max(-1000.0, std::min(1000.0, (int(i)-50)*50.0*0.5 + 10.0));
+        POTHOS_TEST_EQUAL(payload.as<const double *>()[i], x);
+    }
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_converter_scale_offset_clamp)
+{
+    test_converter_scaled("float32"); //fused kernel
+    test_converter_scaled("float64"); //generic fallback
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_converter_parallel)
+{
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int16");
+    auto converter = Pothos::BlockRegistry::make("/blocks/converter", "float32");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "float32");
+    converter.call("setNumWorkers", 3);
+    converter.call("setParallelThreshold", 1024);
+
+    //odd sized buffers exercise the chunk boundaries
+    std::vector<short> expected;
+    for (size_t n = 1; n < 10; n++)
+    {
+        Pothos::BufferChunk b0("int16", n*1237);
+        for (size_t i = 0; i < b0.elements(); i++)
+        {
+            b0.as<short *>()[i] = short(std::rand());
+            expected.push_back(b0.as<const short *>()[i]);
+        }
+        feeder.call("feedBuffer", b0);
+    }
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, converter, 0);
+        topology.connect(converter, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    //check the converted result
+    const Pothos::BufferChunk buffer = collector.call("getBuffer");
+    POTHOS_TEST_EQUAL(buffer.elements(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        POTHOS_TEST_EQUAL(buffer.as<const float *>()[i], float(expected[i]));
+    }
+}
@@ -0,0 +1,48 @@
+// Copyright (c) 2018-2018 Josh Blum
+// SPDX-License-Identifier: BSL-1.0
+
+#include <Pothos/Testing.hpp>
+#include <Pothos/Framework.hpp>
+#include <Pothos/Proxy.hpp>
+#include <iostream>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+static void test_copier(const size_t nonTemporalThreshold, const size_t numWorkers)
+{
+    std::cout << "testing copier, non-temporal threshold " << nonTemporalThreshold << ", workers " << numWorkers << std::endl;
+    auto feeder = Pothos::BlockRegistry::make("/blocks/feeder_source", "int");
+    auto copier = Pothos::BlockRegistry::make("/blocks/copier");
+    auto collector = Pothos::BlockRegistry::make("/blocks/collector_sink", "int");
+    copier.call("setNonTemporalThreshold", nonTemporalThreshold);
+    copier.call("setNumWorkers", numWorkers);
+    copier.call("setParallelThreshold", 1000); //odd sized chunks
+
+    //create a test plan with streams and packets
+    json testPlan;
+    testPlan["enableBuffers"] = true;
+    testPlan["enableMessages"] = true;
+    testPlan["enablePackets"] = true;
+    testPlan["minSize"] = 100;
+    testPlan["maxSize"] = 4000;
+    auto expected = feeder.call("feedTestPlan", testPlan.dump());
+
+    //run the topology
+    {
+        Pothos::Topology topology;
+        topology.connect(feeder, 0, copier, 0);
+        topology.connect(copier, 0, collector, 0);
+        topology.commit();
+        POTHOS_TEST_TRUE(topology.waitInactive());
+    }
+
+    collector.call("verifyTestPlan", expected);
+}
+
+POTHOS_TEST_BLOCK("/blocks/tests", test_copier)
+{
+    test_copier(0, 0); //plain memcpy
+    test_copier(1, 0); //streaming stores with unaligned heads and tails
+    test_copier(1, 2); //streaming stores split across workers
+}